@@ -38,7 +38,7 @@ public:
         m_state = LocalSocksState::Greeting;
     }
 
-    void onReceiveData(const uint8_t* data, size_t length) override {
+    size_t onReceiveData(const uint8_t* data, size_t length) override {
         m_clientBuffer.insert(m_clientBuffer.end(), data, data + length);
 
         while (!m_clientBuffer.empty()) {
@@ -62,6 +62,7 @@ public:
                 break; // Error state
             }
         }
+        return length;
     }
 
     void onClose() override {
@@ -58,8 +58,9 @@ public:
     static void OnConnectorConnectFailed(void* p) {
         static_cast<Socks5StreamHandler*>(p)->HandleConnectorConnectFailed();
     }
-    static void OnConnectorData(void* p, const uint8_t* data, size_t len) {
+    static size_t OnConnectorData(void* p, const uint8_t* data, size_t len) {
         static_cast<Socks5StreamHandler*>(p)->HandleConnectorData(data, len);
+        return len;
     }
     static void OnConnectorClose(void* p) {
         static_cast<Socks5StreamHandler*>(p)->HandleConnectorClose();
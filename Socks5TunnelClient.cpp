@@ -61,7 +61,7 @@ int main1()
     srv.setOnAccepted(OnLocalSocksAccepted, &srv);
 
     // ۲. شروع اتصال به سرور تونل
-    EpollReactor* mainReactor = srv.getRoundRobinShard(); //
+    EpollReactor* mainReactor = srv.getShard(); //
     if (!mainReactor) {
         std::fprintf(stderr, "[Client] Could not get a reactor shard.\n");
         return 1;
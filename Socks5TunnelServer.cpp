@@ -22,9 +22,9 @@ public:
 
     // این تابع مجازی از TCPSocket می‌آید و توسط MultiplexedTunnel بازنویسی شده است.
     // ما نیازی به بازنویسی مجدد آن نداریم، مگر اینکه بخواهیم لاگ بگیریم.
-    // void onReceiveData(const uint8_t* data, size_t len) override {
+    // size_t onReceiveData(const uint8_t* data, size_t len) override {
     //     printf("Server OnRecv %zu bytes\n", len);
-    //     MultiplexedTunnel::onReceiveData(data, len); // فراخوانی پارسر
+    //     return MultiplexedTunnel::onReceiveData(data, len); // فراخوانی پارسر
     // }
 
     void onClose() override {
@@ -28,10 +28,11 @@ class Socks5Proxy {
 public:
     TCPSocket acceptor;
     TCPSocket connector;
-    std::vector<uint8_t> m_clientBuffer;  // Buffer for incoming client data (high-performance, resizable)
     std::vector<uint8_t> m_connectorBuffer;  // Buffer for pending data to connector if not yet connected
     Socks5State state;
     bool supportsNoAuth;  // From greeting
+    bool m_spliceRelay {false};  // bad az Connected, relay ba splice() (TCPSocket::spliceWith)
+    bool m_fastOpen {false};     // early data e client mostaghim too queue e connector, ba SYN mire
 
     Socks5Proxy() : state(Socks5State::Greeting), supportsNoAuth(false) {
 
@@ -58,6 +59,29 @@ public:
         return acceptor.getPointer();
     }
 
+    void setSpliceRelay(bool enable){
+        m_spliceRelay = enable;
+    }
+
+    // batch haye bozorg e har do taraf ba MSG_ZEROCOPY
+    void setZeroCopy(bool enable){
+        acceptor.setZeroCopy(enable);
+        connector.setZeroCopy(enable);
+    }
+
+    // send haye har dor e reactor ba ham (auto-cork), har do taraf
+    void setAutoCork(bool enable){
+        acceptor.setAutoCork(enable);
+        connector.setAutoCork(enable);
+    }
+
+    // TCP Fast Open baraye connect e upstream: byte haye ke client ghabl az reply e SOCKS mifreste
+    // (optimistic data) ba SYN miran, yek RTT kamtar
+    void setFastOpen(bool enable){
+        m_fastOpen = enable;
+        connector.setFastOpen(enable);
+    }
+
     // Call this when a new connection is accepted (e.g., from external accept loop)
     /*
     void initAccepted(int clientFd, EpollReactor* reactor) {
@@ -69,7 +93,6 @@ public:
 
         acceptor.setReactor(reactor);
         state = Socks5State::Greeting;
-        clientBuffer.clear();
         connectorBuffer.clear();
         supportsNoAuth = false;
         // Trigger onAccepted logic
@@ -82,8 +105,8 @@ public:
     bool isPropagatingResume = false;
 
     // Static trampolines for callbacks
-    static void onConnectorReceiveDataTrampoline(void* p, const uint8_t* data, size_t length) {
-        static_cast<Socks5Proxy*>(p)->OnConnectorReceiveData(data, length);
+    static size_t onConnectorReceiveDataTrampoline(void* p, const uint8_t* data, size_t length) {
+        return static_cast<Socks5Proxy*>(p)->OnConnectorReceiveData(data, length);
     }
 
     static void onConnectorCloseTrampoline(void* p) {
@@ -102,8 +125,8 @@ public:
         static_cast<Socks5Proxy*>(p)->OnConnected();
     }
 
-    static void onAcceptorReceiveDataTrampoline(void* p, const uint8_t* data, size_t length) {
-        static_cast<Socks5Proxy*>(p)->OnAcceptorReceiveData(data, length);
+    static size_t onAcceptorReceiveDataTrampoline(void* p, const uint8_t* data, size_t length) {
+        return static_cast<Socks5Proxy*>(p)->OnAcceptorReceiveData(data, length);
     }
 
     static void onAcceptorCloseTrampoline(void* p) {
@@ -134,6 +157,10 @@ public:
     void OnAccepted() {
         printf("onAccepted() fd=%d\n", acceptor.fd());
         connector.setReactor(acceptor.getReactor());
+        //ta greeting nayomade state nadarim, hot upgrade mitoone fd ro bebare
+        acceptor.setHandoffIdle(true);
+        //greeting + request + connect e connector ta in zaman
+        acceptor.setHandshakeDeadline(SOCKS_HANDSHAKE_TIMEOUT_MS);
     }
 
     void OnAcceptorClose() {
@@ -148,6 +175,7 @@ public:
     void OnConnected() {
         printf("onConnected() fd=%d\n", connector.fd());
         state = Socks5State::Connected;
+        acceptor.clearHandshakeDeadline();
 
         // Send success reply to client
         std::vector<uint8_t> reply(10, 0);  // Max size for reply
@@ -159,11 +187,19 @@ public:
         // Bound address and port can be 0.0.0.0:0 for simplicity
         acceptor.send(reply.data(), 10);
 
+        //Server::rebalance har do taraf ro ba ham jabeja mikone
+        acceptor.setRelayPeer(&connector);
+        connector.setRelayPeer(&acceptor);
+
         // Flush any buffered data to connector
         if (!m_connectorBuffer.empty()) {
             connector.send(m_connectorBuffer.data(), m_connectorBuffer.size());
             m_connectorBuffer.clear();
         }
+
+        //az inja payload vared e user space nemishe, pause/resume mesle ghabl
+        if (m_spliceRelay && !acceptor.spliceWith(&connector))
+            printf("splice relay unavailable, fd=%d\n", acceptor.fd());
     }
 
     void OnConnectFailed() {
@@ -179,46 +215,44 @@ public:
         acceptor.close();
     }
 
-    void OnConnectorReceiveData(const uint8_t* data, size_t length) {
+    size_t OnConnectorReceiveData(const uint8_t* data, size_t length) {
         if (acceptor.getStatus() == TCPSocket::Connected && state == Socks5State::Connected) {
             //printf("acceptor::send length[%zu]\n", length);
-            acceptor.send(data, length);
+            acceptor.sendFrom(&connector, data, length);
         } else {
             printf("🔴 acceptor not connected or invalid state, dropping data\n");
         }
+        return length;
     }
 
-    void OnAcceptorReceiveData(const uint8_t* data, size_t length) {
-
+    size_t OnAcceptorReceiveData(const uint8_t* data, size_t length) {
 
+        acceptor.setHandoffIdle(false);
 
-        // Append to buffer to handle fragments
-        m_clientBuffer.insert(m_clientBuffer.end(), data, data + length);
-/*
-        std::cout << "OnAcceptorReceiveData() Buffer (as numbers): ";
-        for (uint8_t byte : m_clientBuffer) {
-            std::cout << static_cast<unsigned int>(byte) << " ";
-        }
-        std::cout << std::endl;
-*/
         // Process based on state (state machine for fragmentation)
-        while (!m_clientBuffer.empty()) {
+        // frame e naghes too rBuffer e acceptor mimoone, dafe badi ba data e jadid az aval miad
+        size_t offset = 0;
+        while (offset < length) {
+            size_t used = 0;
             if (state == Socks5State::Greeting) {
-                if (!ProcessGreeting())
-                    break;
+                used = ProcessGreeting(data + offset, length - offset);
 
             } else if (state == Socks5State::Request) {
-                if (!ProcessRequest())
-                    break;
+                used = ProcessRequest(data + offset, length - offset);
 
             } else if (state == Socks5State::Connecting || state == Socks5State::Connected) {
-                ForwardToConnector();
-                break;  // All data forwarded
+                ForwardToConnector(data + offset, length - offset);
+                return length;  // All data forwarded
             } else {
                 // Error state: drop
-                break;
+                return length;
             }
+
+            if (!used)
+                return state == Socks5State::Error ? length : offset;
+            offset += used;
         }
+        return offset;
     }
 
 
@@ -258,41 +292,39 @@ public:
         isPropagatingResume = false;
     }
 
-    bool ProcessGreeting() {
+    // return: tedad byte e masraf shode, 0 = naghes (ya Error)
+    size_t ProcessGreeting(const uint8_t* data, size_t length) {
         /*
         std::cout << "ProcessGreeting() Buffer (as numbers): ";
-        for (uint8_t byte : m_clientBuffer) {
-            std::cout << static_cast<unsigned int>(byte) << " ";
+        for (size_t i = 0; i < length; ++i) {
+            std::cout << static_cast<unsigned int>(data[i]) << " ";
         }
         std::cout << std::endl;
         */
 
-        if (m_clientBuffer.size() < 3)
-            return false;  // Min: VER + NMETHODS + at least 1 method
+        if (length < 3)
+            return 0;  // Min: VER + NMETHODS + at least 1 method
 
-        if (m_clientBuffer[0] != 0x05) {
+        if (data[0] != 0x05) {
             state = Socks5State::Error;
             SendErrorReply(0xFF);  // No acceptable methods
             acceptor.close();
-            return false;
+            return 0;
         }
 
-        uint8_t nmethods = m_clientBuffer[1];
-        if (m_clientBuffer.size() < 2 + nmethods)
-            return false;  // Wait for full methods
+        uint8_t nmethods = data[1];
+        if (length < 2 + (size_t)nmethods)
+            return 0;  // Wait for full methods
 
         // Check if no-auth (0x00) is supported
         supportsNoAuth = false;
         for (size_t i = 0; i < nmethods; ++i) {
-            if (m_clientBuffer[2 + i] == 0x00) {
+            if (data[2 + i] == 0x00) {
                 supportsNoAuth = true;
                 break;
             }
         }
 
-        // Consume the greeting
-        m_clientBuffer.erase(m_clientBuffer.begin(), m_clientBuffer.begin() + 2 + nmethods);
-
         // Send method selection
         uint8_t response[2] = {0x05, static_cast<uint8_t>(supportsNoAuth ? 0x00 : 0xFF)};
         //uint8_t response[2] = {0x05, supportsNoAuth ? 0x00 : 0xFF};
@@ -301,56 +333,56 @@ public:
         if (!supportsNoAuth) {
             state = Socks5State::Error;
             acceptor.close();
-            return false;
+            return 0;
         }
 
         state = Socks5State::Request;
-        return true;
+        return 2 + nmethods;  // Consume the greeting
     }
 
-    bool ProcessRequest() {
+    size_t ProcessRequest(const uint8_t* data, size_t length) {
         /*
         std::cout << "ProcessRequest() Buffer (as numbers): ";
-        for (uint8_t byte : m_clientBuffer) {
-            std::cout << static_cast<unsigned int>(byte) << " ";
+        for (size_t i = 0; i < length; ++i) {
+            std::cout << static_cast<unsigned int>(data[i]) << " ";
         }
         std::cout << std::endl;
 */
 
-        if (m_clientBuffer.size() < 4)
-            return false;  // Min: VER + CMD + RSV + ATYP
+        if (length < 4)
+            return 0;  // Min: VER + CMD + RSV + ATYP
 
-        if (m_clientBuffer[0] != 0x05) {
+        if (data[0] != 0x05) {
             state = Socks5State::Error;
             SendErrorReply(0x01);  // General failure
             acceptor.close();
-            return false;
+            return 0;
         }
 
-        uint8_t cmd = m_clientBuffer[1];
+        uint8_t cmd = data[1];
         if (cmd != 0x01) {  // Only support CONNECT
             state = Socks5State::Error;
             SendErrorReply(0x07);  // Command not supported
             acceptor.close();
-            return false;
+            return 0;
         }
 
-        uint8_t atyp = m_clientBuffer[3];
+        uint8_t atyp = data[3];
         size_t addrLen = 0;
         if (atyp == 0x01) addrLen = 4;  // IPv4
         else if (atyp == 0x03) {  // Domain
-            if (m_clientBuffer.size() < 5) return false;
-            addrLen = m_clientBuffer[4] + 1;  // Len byte + domain
+            if (length < 5) return 0;
+            addrLen = data[4] + 1;  // Len byte + domain
         } else if (atyp == 0x04) addrLen = 16;  // IPv6
         else {
             state = Socks5State::Error;
             SendErrorReply(0x08);  // Address type not supported
             acceptor.close();
-            return false;
+            return 0;
         }
 
         size_t totalLen = 4 + addrLen + 2;  // + port
-        if (m_clientBuffer.size() < totalLen) return false;  // Wait for full request
+        if (length < totalLen) return 0;  // Wait for full request
 
         // Extract address and port
         std::string host;
@@ -359,25 +391,29 @@ public:
 
         if (atyp == 0x01) {  // IPv4
             char ipStr[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, m_clientBuffer.data() + offset, ipStr, INET_ADDRSTRLEN);
+            inet_ntop(AF_INET, data + offset, ipStr, INET_ADDRSTRLEN);
             host = ipStr;
             offset += 4;
         } else if (atyp == 0x03) {  // Domain
-            uint8_t domainLen = m_clientBuffer[offset];
+            uint8_t domainLen = data[offset];
             offset++;
-            host.assign(reinterpret_cast<const char*>(m_clientBuffer.data() + offset), domainLen);
+            host.assign(reinterpret_cast<const char*>(data + offset), domainLen);
             offset += domainLen;
         } else if (atyp == 0x04) {  // IPv6
             char ipStr[INET6_ADDRSTRLEN];
-            inet_ntop(AF_INET6, m_clientBuffer.data() + offset, ipStr, INET6_ADDRSTRLEN);
+            inet_ntop(AF_INET6, data + offset, ipStr, INET6_ADDRSTRLEN);
             host = ipStr;
             offset += 16;
         }
 
-        port = (m_clientBuffer[offset] << 8) | m_clientBuffer[offset + 1];
+        port = (data[offset] << 8) | data[offset + 1];
 
-        // Consume the request
-        m_clientBuffer.erase(m_clientBuffer.begin(), m_clientBuffer.begin() + totalLen);
+        //early data e hamin read ghabl az connectTo queue mishe (DNS e cache shode hamin ja attempt ro shoroo mikone)
+        size_t earlyLen = 0;
+        if (m_fastOpen && length > totalLen) {
+            earlyLen = length - totalLen;
+            connector.send(data + totalLen, earlyLen);
+        }
 
         // Connect to target
         printf("connectTo: [%s] port: [%d]\n", host.c_str(), port);
@@ -385,22 +421,24 @@ public:
             state = Socks5State::Error;
             SendErrorReply(0x01);  // General failure
             acceptor.close(true);
-            return false;
+            return 0;
         }
 
         state = Socks5State::Connecting;
-        return true;
+        return totalLen + earlyLen;  // Consume the request
     }
 
-    void ForwardToConnector() {
+    void ForwardToConnector(const uint8_t* data, size_t length) {
         if (connector.getStatus() == TCPSocket::Connected && state == Socks5State::Connected) {
-            //printf("connector::send length[%zu]\n", clientBuffer.size());
-            connector.send(m_clientBuffer.data(), m_clientBuffer.size()); //inja bayad pause rresume anjam beshe
+            //printf("connector::send length[%zu]\n", length);
+            connector.sendFrom(&acceptor, data, length); //inja bayad pause rresume anjam beshe
+        } else if (m_fastOpen && connector.getStatus() == TCPSocket::Connecting) {
+            //queue e connector: agar attempt hanooz shoroo nashode (DNS), ba SYN mire
+            connector.send(data, length);
         } else {
             // Buffer if not connected yet
-            m_connectorBuffer.insert(m_connectorBuffer.end(), m_clientBuffer.begin(), m_clientBuffer.end());
+            m_connectorBuffer.insert(m_connectorBuffer.end(), data, data + length);
         }
-        m_clientBuffer.clear();
     }
 
     void SendErrorReply(uint8_t errorCode) {
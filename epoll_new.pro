@@ -34,6 +34,8 @@ SOURCES += \
         src/clsBufferPool.cpp \
         src/clsDNSLookup.cpp \
         src/clsEpollReactor.cpp \
+        src/clsHandoff.cpp \
+        src/clsHappyEyeballs.cpp \
         src/clsIntrusiveList.cpp \
         src/clsMultiplexedTunnel.cpp \
         src/clsSendQueue.cpp \
@@ -41,8 +43,10 @@ SOURCES += \
         src/clsSocketList.cpp \
         clsSocks5Proxy.cpp \
         src/clsTCPSocket.cpp \
+        src/clsTelemetry.cpp \
         src/clsTimer.cpp \
         src/clsTimerManager.cpp \
+        src/clsUringEngine.cpp \
         example_Tunnel_Server.cpp \
         example_Tunnel_client.cpp \
         main.cpp \
@@ -55,6 +59,8 @@ HEADERS += \
     src/clsBufferPool.h \
     src/clsDNSLookup.h \
     src/clsEpollReactor.h \
+    src/clsHandoff.h \
+    src/clsHappyEyeballs.h \
     src/clsIntrusiveList.h \
     src/clsMultiplexedTunnel.h \
     src/clsSendQueue.h \
@@ -63,8 +69,10 @@ HEADERS += \
     src/clsSocketList.h \
     clsSocks5Proxy.h \
     src/clsTCPSocket.h \
+    src/clsTelemetry.h \
     src/clsTimer.h \
     src/clsTimerManager.h \
+    src/clsUringEngine.h \
     src/constants.h \
     src/epoll.h
 
@@ -84,7 +84,7 @@ int main4() {
 
     // create MultiplexedTunnel client
     MultiplexedTunnel* tunnel = new MultiplexedTunnel(true); // client mode
-    tunnel->setReactor(srv.getRoundRobinShard());
+    tunnel->setReactor(srv.getShard());
     tunnel->setOnConnected(onClientConnected, tunnel);
 
 
@@ -5,14 +5,71 @@
 #include <malloc.h>
 #include "clsSocks5Proxy.h"
 
+static bool spliceRelay = false;
+static bool zeroCopy = false;
+static bool autoCork = false;
+static bool fastOpen = false;
+
 TCPSocket* OnAccepted(void* p){
     //Server* srv = static_cast<Server*>(p);
     Socks5Proxy *newWebsocket = new Socks5Proxy;
+    newWebsocket->setSpliceRelay(spliceRelay);
+    newWebsocket->setZeroCopy(zeroCopy);
+    newWebsocket->setAutoCork(autoCork);
+    newWebsocket->setFastOpen(fastOpen);
     return newWebsocket->getSocketBase();
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    // --uring: io_uring backend baraye A/B ba epoll
+    // --least-loaded: acceptor thread be jaye SO_REUSEPORT
+    // --pin: shard ha rooye cpu pin mishan
+    // --numa: BufferPool har shard rooye NUMA node e khodesh
+    // --busy-poll: spin bad az traffic (BUSY_POLL_BUDGET_US), baraye gaming/VoIP
+    // --takeover: listener ha ro az process e ghadimi migire (hot upgrade, 'h' dar process e ghadimi)
+    // --p2c / --p2c-bytes: shard e connection haye khoroji ba power-of-two-choices
+    // --splice: SOCKS bad az connect ba splice() relay mikone (payload vared e user space nemishe)
+    // --zerocopy: batch haye bozorg e onWritable ba MSG_ZEROCOPY
+    // --cork: send ha ta akhare dor e reactor jam mishan, har socket yek sendmsg
+    // --fastopen: TCP Fast Open rooye listener va connect e upstream (early data ba SYN)
+    // --shards N: tedad shard (default 1), 'm' relay ha ro beyne shard ha rebalance mikone
+    ReactorBackend backend = BACKEND_EPOLL;
+    AcceptMode acceptMode = ACCEPT_REUSEPORT;
+    bool cpuAffinity = false;
+    bool numaPlacement = false;
+    bool busyPoll = false;
+    bool takeover = false;
+    ShardPolicy shardPolicy = SHARD_ROUND_ROBIN;
+    int shards = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--uring") == 0)
+            backend = BACKEND_IO_URING;
+        if (strcmp(argv[i], "--least-loaded") == 0)
+            acceptMode = ACCEPT_LEAST_LOADED;
+        if (strcmp(argv[i], "--pin") == 0)
+            cpuAffinity = true;
+        if (strcmp(argv[i], "--numa") == 0)
+            numaPlacement = true;
+        if (strcmp(argv[i], "--busy-poll") == 0)
+            busyPoll = true;
+        if (strcmp(argv[i], "--takeover") == 0)
+            takeover = true;
+        if (strcmp(argv[i], "--p2c") == 0)
+            shardPolicy = SHARD_P2C_CONNECTIONS;
+        if (strcmp(argv[i], "--p2c-bytes") == 0)
+            shardPolicy = SHARD_P2C_QUEUED_BYTES;
+        if (strcmp(argv[i], "--splice") == 0)
+            spliceRelay = true;
+        if (strcmp(argv[i], "--zerocopy") == 0)
+            zeroCopy = true;
+        if (strcmp(argv[i], "--cork") == 0)
+            autoCork = true;
+        if (strcmp(argv[i], "--fastopen") == 0)
+            fastOpen = true;
+        if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+            shards = std::max(1, atoi(argv[++i]));
+    }
 
     //in to libwrench hast max ro az onja begir
     struct rlimit r;
@@ -20,12 +77,29 @@ int main()
     int maxfd = (int)r.rlim_cur;
     std::fprintf(stderr, "maxfd: %d\n", maxfd);
     //Server srv(maxfd, 1);
-    Server srv(maxfd,1);
+    Server srv(maxfd, shards, backend);
 
 
     srv.setUseGarbageCollector(false);
-    srv.AddNewListener(1080, "0.0.0.0");
+    srv.setAcceptMode(acceptMode);
+    srv.setShardPolicy(shardPolicy);
+    if (fastOpen)
+        srv.setFastOpen(FASTOPEN_QUEUE_LEN);
+    srv.setCpuAffinity(cpuAffinity);
+    srv.setNumaPlacement(numaPlacement);
+    if (busyPoll)
+        srv.setBusyPoll(BUSY_POLL_BUDGET_US, true);
+    if (numaPlacement)
+        srv.printPlacement();
     srv.setOnAccepted(OnAccepted, &srv);
+    if (takeover) {
+        if (!srv.adoptHandoff(HANDOFF_SOCKET_PATH)) {
+            std::fprintf(stderr, "takeover failed\n");
+            return 1;
+        }
+    } else {
+        srv.AddNewListener(1080, "0.0.0.0");
+    }
 
 
     if(!srv.start())
@@ -88,7 +162,7 @@ getchar();
 A:
     /*
     Acceptor* outbound = new Acceptor();
-    outbound->setReactor(srv.getRoundRobinShard());
+    outbound->setReactor(srv.getShard());
     //outbound->connectTo("51.195.150.84", 80);
 
     //outbound->connectTo("51.195.150.84", 80);
@@ -102,6 +176,23 @@ A:
             exit(0);
         }
 
+        if(needExit == 't'){
+            srv.printTelemetry();
+        }
+
+        //relay ha az shard e shologh be khalvat
+        if(needExit == 'm'){
+            srv.rebalance();
+        }
+
+        //hot upgrade: process e jadid ba --takeover bayad montazer bashe
+        if(needExit == 'h'){
+            if(srv.handoffTo(HANDOFF_SOCKET_PATH, true)){
+                srv.drain();
+                exit(0);
+            }
+        }
+
         if(needExit == 'r'){
             //outbound->close();
             goto A;
@@ -4,9 +4,12 @@
 // Owns fd, rw buffers, and queue; used via composition by high-level handlers.
 #include "clsIntrusiveList.h"
 #include "clsSendQueue.h"
+#include "constants.h"
 #include <cstdint>
 #include <cstdio>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <chrono>
 
 struct SocketContext
@@ -19,6 +22,17 @@ struct SocketContext
     size_t rBufferLength { 0 };
     SendQueue* writeQueue {nullptr};
     uint64_t lastActive {};
+    struct sockaddr_storage peerAddr {};
+    socklen_t peerAddrLen { 0 };
+    bool readScheduled { false };   // too ready list e reactor hast (read budget tamoom shode)
+    uint32_t armedEvents { 0 };     // events e dakhele kernel (akharin EPOLL_CTL_ADD/MOD)
+    bool interestDirty { false };   // ev.events avaz shode, akhare dor flush mishe
+    bool flushScheduled { false };  // auto-cork: writeQueue akhare dor ba yek sendmsg ersal mishe
+
+    // io_uring backend: op haye dar jaryan va msghdr e sendmsg ta completion
+    uint8_t uringOps { 0 };
+    struct msghdr uringMsg {};
+    struct iovec uringIov[URING_MAX_SEND_IOV] {};
 
     ~SocketContext(){
        // printf("~SocketContext(---------------------------------------------------------------)\n");
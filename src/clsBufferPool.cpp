@@ -1,29 +1,152 @@
 #include "clsBufferPool.h"
 #include "tlsf.h"
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
 
 BufferPool::BufferPool(size_t pool_size) {
     if (pool_size < 4096)
         pool_size = 4096;
 
-    pool_ = malloc(pool_size);
+    // mmap be jaye malloc ta pool page aligned bashe (mbind)
+    pool_ = mmap(nullptr, pool_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool_ == MAP_FAILED) {
+        perror("mmap(BufferPool)");
+        pool_ = nullptr;
+        return;
+    }
+
+    m_poolSize = pool_size;
     m_tlsf = tlsf_create_with_pool(pool_, pool_size);
 
 }
 
 BufferPool::~BufferPool() {
-    tlsf_destroy(m_tlsf);
-    free(pool_);
+    if (m_tlsf)
+        tlsf_destroy(m_tlsf);
+
+    if (pool_)
+        munmap(pool_, m_poolSize);
 }
 
 void *BufferPool::allocate(size_t size) {
-    return tlsf_malloc(m_tlsf, size);
+    void *ptr = tlsf_malloc(m_tlsf, size);
+    if (ptr)
+        m_bytesInUse += tlsf_block_size(ptr);
+    return ptr;
 }
 
 void *BufferPool::reallocate(void *ptr, size_t size) {
-    return tlsf_realloc(m_tlsf, ptr, size);
+    size_t oldSize = ptr ? tlsf_block_size(ptr) : 0;
+    void *newPtr = tlsf_realloc(m_tlsf, ptr, size);
+    if (newPtr || size == 0) {
+        m_bytesInUse -= oldSize;
+        if (newPtr)
+            m_bytesInUse += tlsf_block_size(newPtr);
+    }
+    return newPtr;
 }
 
 void BufferPool::deallocate(void *ptr) {
+    if (ptr)
+        m_bytesInUse -= tlsf_block_size(ptr);
     tlsf_free(m_tlsf, ptr);
 }
 
+void *BufferPool::allocateShared(size_t size) {
+    char *block = static_cast<char*>(allocate(size + SHARED_HEADER));
+    if (!block)
+        return nullptr;
+    *reinterpret_cast<uint32_t*>(block) = 1;
+    return block + SHARED_HEADER;
+}
+
+void *BufferPool::reallocateShared(void *ptr, size_t size) {
+    if (!ptr)
+        return allocateShared(size);
+    char *block = static_cast<char*>(reallocate(static_cast<char*>(ptr) - SHARED_HEADER, size + SHARED_HEADER));
+    return block ? block + SHARED_HEADER : nullptr;
+}
+
+void BufferPool::retain(void *ptr) {
+    (*reinterpret_cast<uint32_t*>(static_cast<char*>(ptr) - SHARED_HEADER))++;
+}
+
+void BufferPool::release(void *ptr) {
+    if (!ptr)
+        return;
+    char *block = static_cast<char*>(ptr) - SHARED_HEADER;
+    if (--(*reinterpret_cast<uint32_t*>(block)) == 0)
+        deallocate(block);
+}
+
+uint32_t BufferPool::refCount(const void *ptr) const {
+    return *reinterpret_cast<const uint32_t*>(static_cast<const char*>(ptr) - SHARED_HEADER);
+}
+
+size_t BufferPool::bytesInUse() const
+{
+    return m_bytesInUse;
+}
+
+void BufferPool::addQueued(size_t len)
+{
+    m_queuedBytes += len;
+}
+
+void BufferPool::subQueued(size_t len)
+{
+    m_queuedBytes -= len;
+}
+
+size_t BufferPool::queuedBytes() const
+{
+    return m_queuedBytes;
+}
+
+bool BufferPool::bindToNode(int node, bool prefault)
+{
+    if (!pool_ || node < 0 || node >= (int)(sizeof(unsigned long) * 8))
+        return false;
+
+    // PREFERRED: agar node por beshe az node dige migire, OOM nemishim
+    unsigned long nodemask = 1UL << node;
+    if (syscall(__NR_mbind, pool_, m_poolSize, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8, MPOL_MF_MOVE) < 0) {
+        perror("mbind(BufferPool)");
+        return false;
+    }
+
+    m_numaNode = node;
+
+    if (prefault) {
+        // kernel >= 5.14, vagarna page be page touch mikonim
+        if (madvise(pool_, m_poolSize, MADV_POPULATE_WRITE) < 0) {
+            long pageSize = sysconf(_SC_PAGESIZE);
+            volatile char *p = static_cast<volatile char*>(pool_);
+            for (size_t off = 0; off < m_poolSize; off += pageSize)
+                p[off] = p[off];
+        }
+    }
+
+    return true;
+}
+
+int BufferPool::numaNode() const
+{
+    return m_numaNode;
+}
+
+int BufferPool::residentNode() const
+{
+    if (!pool_)
+        return -1;
+
+    int node = -1;
+    if (syscall(__NR_get_mempolicy, &node, nullptr, 0, pool_, MPOL_F_NODE | MPOL_F_ADDR) < 0)
+        return -1;
+
+    return node;
+}
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <tlsf.h>
 #include <cstddef>
+#include <cstdint>
 
 class BufferPool {
 public:
@@ -12,9 +13,34 @@ public:
     void* allocate(size_t size);
     void* reallocate(void* ptr, size_t size);
     void deallocate(void* ptr);
+    // slab e refcount shode (header ghabl az pointer), rBuffer ke ba reference too SendQueue e peer mire.
+    // refCount ba 1 shoroo mishe, akharin release azad mikone. faghat thread e shard
+    void* allocateShared(size_t size);
+    // faghat vaghti refCount == 1
+    void* reallocateShared(void* ptr, size_t size);
+    void retain(void* ptr);
+    void release(void* ptr);
+    uint32_t refCount(const void* ptr) const;
+    size_t bytesInUse() const;
+    // byte haye ersal nashode dar SendQueue haye in pool (SendQueue update mikone), rBuffer ha hesab nemishan
+    void addQueued(size_t len);
+    void subQueued(size_t len);
+    size_t queuedBytes() const;
+
+    // NUMA: pool ro rooye node mibande (page haye ghablan fault shode move mishan)
+    bool bindToNode(int node, bool prefault = true);
+    int numaNode() const;
+    // node e vagheiye avalin page e pool (baraye check e placement), -1 = unknown
+    int residentNode() const;
 
 private:
+    static constexpr size_t SHARED_HEADER = 16;    // refcount, alignment e data hefz mishe
+
     void* pool_ = nullptr;
+    size_t m_poolSize = 0;
+    size_t m_bytesInUse = 0;
+    size_t m_queuedBytes = 0;
+    int m_numaNode = -1;
     tlsf_t m_tlsf = nullptr;
 };
 
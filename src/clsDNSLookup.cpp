@@ -578,7 +578,21 @@ bool DNSLookup::parse_dns_response(const uint8_t* packet, size_t len, uint16_t q
     return !ips.empty();
 }
 
+void DNSLookup::cancel(void *user_data) {
+    //erase na: maintenance/on_dns_read momkene hamin alan rooye m_pending bashan
+    for (auto& p : m_pending) {
+        if (p.second->user_data == user_data) {
+            p.second->cb = nullptr;
+            p.second->user_data = nullptr;
+        }
+    }
+}
+
 void DNSLookup::call_callback(DNSRequest* req, const std::vector<std::string>& ips_vec) {
+    //cancel shode
+    if (!req->cb)
+        return;
+
     size_t count = ips_vec.size();
     char** ips = nullptr;
     if (count > 0) {
@@ -39,6 +39,9 @@ public:
     ~DNSLookup();
 
     bool resolve(const char *hostname, callback_t cb, void *user_data, DNSLookup::QUERY_TYPE QuryType = DNSLookup::A);
+    // request haye pending e user_data dige callback nemigiran (user_data momkene delete beshe),
+    // query baghi mimoone va javab faghat cache mishe
+    void cancel(void *user_data);
     void on_dns_read();
     void maintenance();
     int fd() const;
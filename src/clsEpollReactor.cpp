@@ -4,9 +4,20 @@
 #include "clsUDPSocket.h"
 #include "clsTimer.h"
 #include "clsTimerManager.h"
+#include "clsUringEngine.h"
+#include "clsHandoff.h"
+#include "clsHappyEyeballs.h"
 #include <malloc.h>
+#include <algorithm>
 
-EpollReactor::EpollReactor(int id, int maxConnection, int max_events): m_reactorID(id), m_maxEvent(max_events), m_maxConnection(maxConnection), m_bufferPool(BUFFER_POOL_SIZE)
+static uint64_t monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+EpollReactor::EpollReactor(int id, int maxConnection, int max_events, ReactorBackend backend): m_reactorID(id), m_maxEvent(max_events), m_maxConnection(maxConnection), m_backend(backend), m_bufferPool(BUFFER_POOL_SIZE)
 {
     init();
 }
@@ -31,6 +42,10 @@ EpollReactor::~EpollReactor() {
         delete m_pTimers;
     }
 
+    if(m_pUring){
+        delete m_pUring;
+    }
+
 }
 
 void EpollReactor::init()
@@ -47,8 +62,23 @@ void EpollReactor::init()
     m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     if(m_wakeupFd == -1)
         throw std::runtime_error("eventfd");
-    struct epoll_event ev;
-    //add_fd(m_wakeupFd,&ev, EPOLLIN);
+
+    //io_uring backend, agar kernel support nakone epoll mimoone
+    if(m_backend == BACKEND_IO_URING){
+        m_pUring = new UringEngine(this);
+        if(!m_pUring->init(URING_QUEUE_DEPTH)){
+            printf("reactor[%d]: io_uring not available, fallback to epoll\n", m_reactorID);
+            delete m_pUring;
+            m_pUring = nullptr;
+            m_backend = BACKEND_EPOLL;
+        }
+    }
+
+    //wakeup baraye stop() va post(), bedoone in ta timeout e epoll_wait montazer mimoonim
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    if(!register_fd(m_wakeupFd, &ev, IS_WAKEUP_SOCKET, this))
+        throw std::runtime_error("register wakeup fd");
 
     //
     m_pDNSLookup = new DNSLookup(this);
@@ -61,34 +91,23 @@ void EpollReactor::init()
     m_pTimers = new TimerManager;
     m_pTimers->setReactor(this);
 
-    /*
-    //Managing IDLE Connections
-    m_pTimers->addTimer(IDLE_CONNECTION_INTERVAL_MS, [this] () {
-        maintenance();
-    });
-    */
-
-    //Managing closing stalled Connections
-    m_pTimers->addTimer(CLOSE_WAIT_INTERVAL_MS, [this] () {
-        maintenance();
-    });
-
+    //idle / Closing / connect: deadline e har socket (TCPSocket), scan nadarim
 
     //update now time
-    m_pTimers->addTimer(UPDATE_CACHED_NOW, [this] {
-        this->updateCashedTime();
-    });
+    m_pTimers->start(&m_cachedNowTimer, UPDATE_CACHED_NOW, [] (void *p) {
+        static_cast<EpollReactor*>(p)->updateCashedTime();
+    }, this);
 
 
     //DNS timeout timer
-    m_pTimers->addTimer(DNS_TIMEOUT_INTERVAL_MS, [this] {
-        this->checkDnsTimeouts();
-    });
+    m_pTimers->start(&m_dnsTimer, DNS_TIMEOUT_INTERVAL_MS, [] (void *p) {
+        static_cast<EpollReactor*>(p)->checkDnsTimeouts();
+    }, this);
 
     //Garbage collector timer
-    m_pTimers->addTimer(GARBAGE_COLLECTOR_INTERVAL_MS, [this] {
-        this->runGarbageCollector();
-    });
+    m_pTimers->start(&m_gcTimer, GARBAGE_COLLECTOR_INTERVAL_MS, [] (void *p) {
+        static_cast<EpollReactor*>(p)->runGarbageCollector();
+    }, this);
 
 }
 
@@ -114,12 +133,13 @@ bool EpollReactor::addFlags(SocketContext *pContext, uint32_t flags)
     if (!(pContext->ev.events & flags)){
         pContext->ev.events |= flags;
 
-        //printf("mod_add() flags: %d\n", flags);
-
-        if(epoll_ctl(m_epollSocket, EPOLL_CTL_MOD, pContext->fd, &pContext->ev) == -1){
-            perror("EPOLL_CTL_MOD mod_add");
-            return false;
+        if(m_pUring){
+            m_pUring->modify(pContext);
+            return true;
         }
+
+        //printf("mod_add() flags: %d\n", flags);
+        markInterestDirty(pContext);
         return true;
     }
     return false;
@@ -130,18 +150,56 @@ void EpollReactor::removeFlags(SocketContext *pContext, uint32_t flags)
     if (pContext->ev.events & flags) {
         pContext->ev.events &= ~flags;
 
-        //printf("mod_remove() flags: %d\n", flags);
+        // io_uring: op e dar jaryan tamoom mishe va dige arm nemishe
+        if(m_pUring)
+            return;
 
-        if(epoll_ctl(m_epollSocket, EPOLL_CTL_MOD, pContext->fd, &pContext->ev) == -1){
-            perror("EPOLL_CTL_MOD mod_remove");
-        }
+        //printf("mod_remove() flags: %d\n", flags);
+        markInterestDirty(pContext);
     }else{
         printf("removeFlags00000000000000000000000000000000000\n");
     }
 }
 
+void EpollReactor::markInterestDirty(SocketContext *pContext)
+{
+    if (pContext->interestDirty)
+        return;
+
+    pContext->interestDirty = true;
+    uint64_t key = pContext->ev.data.u64;
+    m_dirtyInterest.push_back(key);
+}
+
+void EpollReactor::flushInterest()
+{
+    for (uint64_t key : m_dirtyInterest) {
+        SockInfo *pInfo = m_pConnectionList->get(extract_fd(key), extract_gen(key));
+        if (!pInfo || pInfo->type != IS_TCP_SOCKET || !pInfo->socketBasePtr)
+            continue;
+
+        SocketContext *pContext = static_cast<TCPSocket*>(pInfo->socketBasePtr)->getSocketContext();
+        pContext->interestDirty = false;
+
+        //flip-flop (masalan EPOLLOUT on/off dar yek dor): syscall nemikhad
+        if (pContext->ev.events == pContext->armedEvents)
+            continue;
+
+        m_telemetry.epollCtl.add(1);
+        if (epoll_ctl(m_epollSocket, EPOLL_CTL_MOD, pContext->fd, &pContext->ev) == -1) {
+            perror("EPOLL_CTL_MOD");
+            continue;
+        }
+        pContext->armedEvents = pContext->ev.events;
+    }
+    m_dirtyInterest.clear();
+}
+
 void EpollReactor::del_fd(int fd, bool removeFromList) {
-    epoll_ctl(m_epollSocket, EPOLL_CTL_DEL, fd, nullptr);
+    if(m_pUring)
+        m_pUring->unwatch(fd);
+    else
+        epoll_ctl(m_epollSocket, EPOLL_CTL_DEL, fd, nullptr);
     if(removeFromList)
         m_pConnectionList->remove(fd);
 }
@@ -158,23 +216,58 @@ bool EpollReactor::add_fd(int fd, epoll_event *pEvent, uint32_t events)
 }
 
 
-bool EpollReactor::add_listener(int port)
+bool EpollReactor::add_listener(int port, const std::vector<int> &steerCpus, int fastOpenQueue)
+{
+    int listen_fd = createListenSocket(port, fastOpenQueue);
+    if(listen_fd < 0)
+        return false;
+
+    // shard pin shode: connection haye cpu khodesh ro begire
+    if(m_cpu >= 0)
+        TCPSocket::setSocketIncomingCpu(listen_fd, m_cpu);
+
+    // baraye kole reuseport group, faghat rooye avalin listener
+    if(steerCpus.size() > 1)
+        TCPSocket::attachCpuSteering(listen_fd, steerCpus);
+
+    // add to listener list
+    m_listenerList.push_back(listen_fd);
+
+    // add listener fd to epoll
+    struct epoll_event listen_ev;
+    listen_ev.events = EPOLL_LISTINER_EVENTS;
+    bool ret = register_fd(listen_fd, &listen_ev, IS_TCP_LISTENER, nullptr);
+    return ret;
+}
+
+bool EpollReactor::adoptListener(int listen_fd)
+{
+    if(TCPSocket::setSocketNonblocking(listen_fd) == -1) {
+        perror("fcntl");
+        return false;
+    }
+
+    m_listenerList.push_back(listen_fd);
+
+    struct epoll_event listen_ev;
+    listen_ev.events = EPOLL_LISTINER_EVENTS;
+    return register_fd(listen_fd, &listen_ev, IS_TCP_LISTENER, nullptr);
+}
+
+int EpollReactor::createListenSocket(int port, int fastOpenQueue)
 {
     // Dual-Stack ipv4 and ipv6
     int listen_fd = ::socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if(listen_fd < 0) {
         perror("socket(AF_INET6)");
-        return false;
+        return -1;
     }
 
-    // add to listener list
-    m_listenerList.push_back(listen_fd);
-
     // set non blocking socket
     if(TCPSocket::setSocketNonblocking(listen_fd) == -1) {
         perror("fcntl");
         ::close(listen_fd);
-        return false;
+        return -1;
     }
 
     // enable multi listiner
@@ -188,9 +281,13 @@ bool EpollReactor::add_listener(int port)
     if (setsockopt(listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &optval, sizeof(optval)) < 0) {
         perror("setsockopt(IPV6_V6ONLY)");
         ::close(listen_fd);
-        return false;
+        return -1;
     }
 
+    // early data e client ba SYN (cookie ro kernel mide)
+    if (fastOpenQueue > 0)
+        TCPSocket::setSocketFastOpen(listen_fd, fastOpenQueue);
+
     // IPv4 and IPv6
     sockaddr_in6 Addrinfo {};
     Addrinfo.sin6_family = AF_INET6;
@@ -200,20 +297,25 @@ bool EpollReactor::add_listener(int port)
     if(bind(listen_fd, (sockaddr*) &Addrinfo, sizeof Addrinfo) < 0) {
         perror("error bind");
         ::close(listen_fd);
-        return false;
+        return -1;
     }
 
     if(::listen(listen_fd, LISTEN_BACKLOG) < 0) {
         perror("error listen");
         ::close(listen_fd);
-        return false;
+        return -1;
     }
 
-    // add listener fd to epoll
-    struct epoll_event listen_ev;
-    listen_ev.events = EPOLL_LISTINER_EVENTS;
-    bool ret = register_fd(listen_fd, &listen_ev, IS_TCP_LISTENER, nullptr);
-    return ret;
+    return listen_fd;
+}
+
+bool EpollReactor::holdInflightSend(SocketContext *pContext)
+{
+    // epoll: sendmsg sync e, kernel copy karde
+    if(!m_pUring)
+        return false;
+
+    return m_pUring->holdSend(pContext);
 }
 
 void EpollReactor::stop_listener()
@@ -248,28 +350,126 @@ void EpollReactor::adoptAccepted(int m_fd) {
             break;
         }
 
-        //set socket options
-        TCPSocket::setSocketShared(fd, true);
-        TCPSocket::setSocketResourceAddress(fd, true);
-        TCPSocket::setSocketNoDelay(fd, true);
-        TCPSocket::setSocketKeepAlive(fd, true);
+        acceptFd(fd);
+    }
+}
+
+void EpollReactor::handoffAccepted(int fd)
+{
+    //ghabl az post shomorde mishe ta acceptor dar burst hamash ro be yek shard nade
+    m_pendingHandoffs.fetch_add(1, std::memory_order_relaxed);
+    post([this, fd] {
+        //pending ta publish e count e jadid (endOfIteration) kam nemishe, dar gheir e in soorat
+        //beyne in do, connection too load() nist va acceptor dobare hamin shard ro entekhab mikone
+        m_handoffsAccepted++;
+        acceptFd(fd);
+    });
+}
 
-        TCPSocket *pSocketbase = nullptr;
-        if (m_onAcceptCallback) {
-            pSocketbase = m_onAcceptCallback(m_onAcceptCallbackCtx);
-        }
+uint32_t EpollReactor::load() const
+{
+    //aval pending (acquire): age kam shode, count e publish shode ham dide mishe
+    uint32_t pending = m_pendingHandoffs.load(std::memory_order_acquire);
+    return m_publishedConnections.load(std::memory_order_relaxed) + pending + m_pendingPicks.load(std::memory_order_relaxed);
+}
 
-        if (!pSocketbase) {
-            //onAccepted callback function not found
-            ::close(fd);
-            continue;
-        }
+uint64_t EpollReactor::queuedBytes() const
+{
+    return m_publishedQueuedBytes.load(std::memory_order_relaxed);
+}
+
+void EpollReactor::noteRecvBuffer(size_t oldCapacity, size_t newCapacity)
+{
+    m_recvBufferBytes += std::max(newCapacity, RECV_BUFFER_MIN);
+    m_recvBufferBytes -= std::max(oldCapacity, RECV_BUFFER_MIN);
+}
+
+size_t EpollReactor::recvBufferBytes() const
+{
+    return m_recvBufferBytes;
+}
+
+void EpollReactor::notePicked()
+{
+    m_pendingPicks.fetch_add(1, std::memory_order_relaxed);
+}
+
+ShardTelemetry *EpollReactor::telemetry()
+{
+    return &m_telemetry;
+}
+
+const ShardTelemetry *EpollReactor::telemetry() const
+{
+    return &m_telemetry;
+}
+
+uint32_t EpollReactor::connections() const
+{
+    uint32_t pending = m_pendingHandoffs.load(std::memory_order_acquire);
+    return m_publishedConnections.load(std::memory_order_relaxed) + pending;
+}
 
-        //set reactor
-        pSocketbase->setReactor(this);
-        //adopt in class
-        pSocketbase->_accepted(fd);
+void EpollReactor::handoff(int unixSock, bool includeIdleConnections)
+{
+    // listener ha: process e jadid az hamin socket ha accept mikone
+    for (int fd : m_listenerList) {
+        sockaddr_in6 addr {};
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (sockaddr*)&addr, &len);
+        Handoff::sendFd(unixSock, Handoff::LISTENER, ntohs(addr.sin6_port), fd);
+    }
+    stop_listener();
+
+    if (!includeIdleConnections)
+        return;
+
+    //ghabl az detach jam mikonim, detach active list ro taghir mide
+    std::vector<TCPSocket*> idleSockets;
+    m_pConnectionList->forEachActive([&](SockInfo* pSocketInfo) {
+        if (pSocketInfo->type != IS_TCP_SOCKET || !pSocketInfo->socketBasePtr)
+            return;
+
+        TCPSocket *pSocket = static_cast<TCPSocket*>(pSocketInfo->socketBasePtr);
+        if (pSocket->isHandoffIdle() && pSocket->getStatus() != TCPSocket::Closed && pSocket->getSocketContext()->writeQueue->empty())
+            idleSockets.push_back(pSocket);
+    });
+
+    for (TCPSocket *pSocket : idleSockets) {
+        if (Handoff::sendFd(unixSock, Handoff::CONNECTION, 0, pSocket->fd()))
+            pSocket->detach();
+    }
+
+    printf("reactor[%d]: handed off %zu idle connections\n", m_reactorID, idleSockets.size());
+}
+
+void EpollReactor::acceptFd(int fd)
+{
+    m_telemetry.accepts.add(1);
+
+    //set socket options
+    TCPSocket::setSocketShared(fd, true);
+    TCPSocket::setSocketResourceAddress(fd, true);
+    TCPSocket::setSocketNoDelay(fd, true);
+    TCPSocket::setSocketKeepAlive(fd, true);
+    if (m_busyPollSockets)
+        TCPSocket::setSocketBusyPoll(fd, m_busyPollBudgetUs);
+
+    TCPSocket *pSocketbase = nullptr;
+    if (m_onAcceptCallback) {
+        pSocketbase = m_onAcceptCallback(m_onAcceptCallbackCtx);
+    }
+
+    if (!pSocketbase) {
+        //onAccepted callback function not found
+        ::close(fd);
+        return;
     }
+
+    //set reactor
+    pSocketbase->setReactor(this);
+    //adopt in class
+    pSocketbase->_accepted(fd);
 }
 
 bool EpollReactor::register_fd(int fd, epoll_event *pEvent,SockTypes sockType, void* ptr)
@@ -291,6 +491,16 @@ bool EpollReactor::register_fd(int fd, epoll_event *pEvent,SockTypes sockType, v
 
     //make key
     pEvent->data.u64 = make_key(fd, sockinfo->genID);
+    if (sockType == IS_TCP_SOCKET && ptr) {
+        SocketContext *pContext = static_cast<TCPSocket*>(ptr)->getSocketContext();
+        pContext->armedEvents = pEvent->events;
+        pContext->interestDirty = false;
+    }
+    if (m_pUring) {
+        m_pUring->watch(fd, sockinfo->genID, sockType, ptr, pEvent->events);
+        return true;
+    }
+
     if (epoll_ctl(m_epollSocket, EPOLL_CTL_ADD, fd, pEvent) == -1) {
         perror("epoll_ctl add");
         return false;
@@ -309,6 +519,11 @@ bool EpollReactor::getIPbyName(const char *hostname, DNSLookup::callback_t callb
     return m_pDNSLookup->resolve(hostname, callback, p, QuryType);
 }
 
+void EpollReactor::cancelIPbyName(void *p)
+{
+    m_pDNSLookup->cancel(p);
+}
+
 void EpollReactor::deleteLater(TCPSocket *pSockBase)
 {
     if(pSockBase)
@@ -321,6 +536,21 @@ void EpollReactor::updateCashedTime()
 }
 
 
+TimerManager *EpollReactor::timers()
+{
+    return m_pTimers;
+}
+
+void EpollReactor::setIdleTimeout(int secs)
+{
+    m_idleTimeoutSecs = secs;
+}
+
+int EpollReactor::idleTimeout() const
+{
+    return m_idleTimeoutSecs;
+}
+
 BufferPool *EpollReactor::bufferPool()
 {
     return &m_bufferPool;
@@ -331,6 +561,63 @@ uint64_t EpollReactor::getCachedNow() const
     return m_cached_now.tv_sec;
 }
 
+ReactorBackend EpollReactor::backend() const
+{
+    return m_backend;
+}
+
+void EpollReactor::setCpu(int cpu)
+{
+    m_cpu = cpu;
+}
+
+int EpollReactor::cpu() const
+{
+    return m_cpu;
+}
+
+void EpollReactor::setBusyPoll(int budget_us, bool socketBusyPoll)
+{
+    m_busyPollBudgetUs = budget_us > 0 ? budget_us : 0;
+    m_busyPollSockets = socketBusyPoll && m_busyPollBudgetUs > 0;
+}
+
+int EpollReactor::busyPollSocketUs() const
+{
+    return m_busyPollSockets ? m_busyPollBudgetUs : 0;
+}
+
+int EpollReactor::nextWaitTimeout(bool hadEvents, int idleTimeout_ms)
+{
+    //ready list khali nist, nabayad block konim
+    if (!m_readyList.empty())
+        return 0;
+
+    if (m_busyPollBudgetUs == 0)
+        return idleTimeout_ms;
+
+    uint64_t nowNs = monotonicNs();
+
+    // traffic dare miad: spin, idle shod: block ta event e badi
+    if (hadEvents)
+        m_lastEventNs = nowNs;
+
+    if (nowNs - m_lastEventNs < (uint64_t)m_busyPollBudgetUs * 1000ULL)
+        return 0;
+
+    return idleTimeout_ms;
+}
+
+bool EpollReactor::setNumaNode(int node)
+{
+    return m_bufferPool.bindToNode(node);
+}
+
+int EpollReactor::numaNode() const
+{
+    return m_bufferPool.numaNode();
+}
+
 
 
 void EpollReactor::onTCPEvent(int fd, uint32_t &ev, void *ptr){
@@ -341,6 +628,13 @@ void EpollReactor::onTCPEvent(int fd, uint32_t &ev, void *ptr){
         return;
     }
 
+    //MSG_ZEROCOPY completion ham EPOLLERR mide, baghie ye event ha mesle ghabl
+    if ((ev & EPOLLERR) && pSockBase->readErrorQueue()) {
+        ev &= ~EPOLLERR;
+        if (pSockBase->getStatus() == TCPSocket::Closed)
+            return;
+    }
+
     if (ev & EPOLLERR) {
         int err = pSockBase->getErrorCode();
         printf("EPOLLERR: fd=%d, error=%d\n", fd, err);
@@ -352,7 +646,7 @@ void EpollReactor::onTCPEvent(int fd, uint32_t &ev, void *ptr){
     if (ev & EPOLLHUP) {
         //#mohem inja raftare gheyre hamahang ba close hast
         printf("EPOLLHUP: fd=%d\n", fd);
-        if (pSockBase->getSocketContext()->writeQueue->empty()) {
+        if (!pSockBase->hasPendingWrite()) {
             pSockBase->close();
             //m_GCList.retire(pSockBase);   //inja add beshe to garbage collector
         } else {
@@ -455,14 +749,68 @@ void EpollReactor::runGarbageCollector()
     }
 }
 
+void EpollReactor::dispatchEvent(SockInfo *socketInfo, int fd, uint32_t ev)
+{
+    //printf("socketInfo type[%d] ev:[%d]\n", socketInfo->type, ev);
+
+    if (socketInfo->type == IS_TCP_LISTENER) {
+        adoptAccepted(fd);
+        return;
+    }
+
+    if (socketInfo->type == IS_TCP_SOCKET) {
+
+        onTCPEvent(fd, ev, socketInfo->socketBasePtr);
+        return;
+    }
+
+    if (socketInfo->type == IS_UDP_SOCKET) {
+        onUDPEvent(fd, ev, socketInfo->socketBasePtr);
+        return;
+    }
+
+    if (socketInfo->type == IS_TIMER_SOCKET) {
+        onTimerEvent(fd, ev, socketInfo->socketBasePtr);
+        return;
+    }
+
+    if (socketInfo->type == IS_TIMER_MANAGER_SOCKET) {
+        onTimerManagerEvent(fd, ev, socketInfo->socketBasePtr);
+        return;
+    }
+
+
+    if (socketInfo->type == IS_DNS_LOOKUP_SOCKET) {
+        onDNSEvent(fd, ev, socketInfo->socketBasePtr);
+        return;
+    }
+
+    if (socketInfo->type == IS_WAKEUP_SOCKET) {
+        onWakeupEvent(fd, ev);
+        return;
+    }
+
+    if (socketInfo->type == IS_CONNECT_ATTEMPT) {
+        static_cast<HappyEyeballs*>(socketInfo->socketBasePtr)->onAttemptEvent(fd, ev);
+        return;
+    }
+}
+
 void EpollReactor::run(std::atomic<bool> &stop)
 {
     printf("EpollReactor::run()\n");
 
+    if (m_pUring) {
+        m_pUring->run(stop);
+        shutdown_all();
+        return;
+    }
+
     std::vector <epoll_event> evs(m_maxEvent);
+    int timeout = EPOLL_WAIT_TIMEOUT_MS;
     while(!stop.load(std::memory_order_relaxed))
     {
-        int n = epoll_wait(m_epollSocket, evs.data(), (int)evs.size(), 1000); //1000 ro be -1 taghir dadim baraye mikrotik container, zamani ke timeout nadashte bashe ta eventi nayad epoll faal nemishe pass agar bekhaym barname ro be soorat amn bebabndim nemishe dge
+        int n = epoll_wait(m_epollSocket, evs.data(), (int)evs.size(), timeout); //1000 ro be -1 taghir dadim baraye mikrotik container, zamani ke timeout nadashte bashe ta eventi nayad epoll faal nemishe pass agar bekhaym barname ro be soorat amn bebabndim nemishe dge
         //printf("n %d\n", n);
 
         if(n < 0) {
@@ -473,6 +821,8 @@ void EpollReactor::run(std::atomic<bool> &stop)
             break;
         }
 
+        beginIteration(n);
+
         for(int i = 0; i < n; ++i)
         {
             uint64_t key = evs[i].data.u64;
@@ -490,52 +840,13 @@ void EpollReactor::run(std::atomic<bool> &stop)
                 continue;
             }
 
-            //printf("socketInfo type[%d] ev:[%d]\n", socketInfo->type, ev);
-
-            if (socketInfo->type == IS_TCP_LISTENER) {
-                adoptAccepted(fd);
-                continue;
-            }
-
-            if (socketInfo->type == IS_TCP_SOCKET) {
-
-                onTCPEvent(fd, ev, socketInfo->socketBasePtr);
-                continue;
-            }
-
-            if (socketInfo->type == IS_UDP_SOCKET) {
-                onUDPEvent(fd, ev, socketInfo->socketBasePtr);
-                continue;
-            }
-
-            if (socketInfo->type == IS_TIMER_SOCKET) {
-                onTimerEvent(fd, ev, socketInfo->socketBasePtr);
-                continue;
-            }
-
-            if (socketInfo->type == IS_TIMER_MANAGER_SOCKET) {
-                onTimerManagerEvent(fd, ev, socketInfo->socketBasePtr);
-                continue;
-            }
-
-
-            if (socketInfo->type == IS_DNS_LOOKUP_SOCKET) {
-                onDNSEvent(fd, ev, socketInfo->socketBasePtr);
-                continue;
-            }
+            dispatchEvent(socketInfo, fd, ev);
             //int fd = evs[i].data.fd;
             //printf("ev: %d\n", ev);
-
-            /*
-            if(fd == m_wakeupFd) {
-                uint64_t x;
-                read(m_wakeupFd, &x, sizeof x);
-                continue;
-            }*/
-
-
         }
 
+        endOfIteration();
+        timeout = nextWaitTimeout(n > 0, EPOLL_WAIT_TIMEOUT_MS);
     }
 
     shutdown_all();
@@ -546,108 +857,226 @@ void EpollReactor::wake() {
     write(m_wakeupFd, &one, sizeof one);
 }
 
+void EpollReactor::post(Task fn)
+{
+    m_postedTasks.enqueue(std::move(fn));
+
+    //faghat avalin post bad az drain eventfd ro write mikone
+    if (!m_wakeupPending.exchange(true, std::memory_order_acq_rel))
+        wake();
+}
 
-void EpollReactor::maintenance()
+void EpollReactor::onWakeupEvent(int fd, uint32_t &ev)
 {
+    if (!(ev & EPOLLIN))
+        return;
 
-    /* mohem*/
-    auto now = getCachedNow();
-    std::vector<SockInfo*> socketsToClose;
+    uint64_t x;
+    while (read(fd, &x, sizeof x) > 0) {}
+    m_hasPostedTasks = true;
+}
 
-    m_pConnectionList->forEachActive([&](SockInfo* pSocketInfo) {
+void EpollReactor::scheduleRead(SocketContext *pContext)
+{
+    if (pContext->readScheduled)
+        return;
 
-        if (pSocketInfo->type == IS_NOT_SET)
-            return;
+    pContext->readScheduled = true;
+    m_readyList.push_back(pContext->ev.data.u64);
+}
 
-        TCPSocket* pCSock = nullptr;
-        // faghat socket haiy ke momkene
-        if (pSocketInfo->type == IS_TCP_SOCKET || pSocketInfo->type == IS_UDP_SOCKET)
-        {
-            pCSock = static_cast<TCPSocket*>(pSocketInfo->socketBasePtr);
-        }
+void EpollReactor::runReadyList()
+{
+    //socket haye ke dobare budget ro tamoom konan baraye dor e baad mimoonan
+    m_readyListRunning.swap(m_readyList);
+    for (uint64_t key : m_readyListRunning) {
+        SockInfo *pInfo = m_pConnectionList->get(extract_fd(key), extract_gen(key));
+        if (!pInfo || pInfo->type != IS_TCP_SOCKET || !pInfo->socketBasePtr)
+            continue;
 
-        if (!pCSock)
-            return;
+        TCPSocket *pSocket = static_cast<TCPSocket*>(pInfo->socketBasePtr);
+        pSocket->getSocketContext()->readScheduled = false;
 
-        // check timeout
-        auto duration = now - pCSock->getLastActiveTime();
-        if (pCSock->getStatus() == TCPSocket::Closing)
-        {
-            if (duration >= CLOSING_TIMEOUT_SECS) {
-                printf("Closing Timeout: fd=%d\n", pSocketInfo->fd);
+        //pause shode: resume_reading() EPOLLIN ro dobare arm mikone
+        if (!(pSocket->getSocketContext()->ev.events & EPOLLIN) || pSocket->getStatus() == TCPSocket::Closed)
+            continue;
 
-                // add to list for close
-                socketsToClose.push_back(pSocketInfo);
-            }
-        }
-        else if (pCSock->getStatus() == TCPSocket::Connected)
-        {
-            /*
-            //close IDLE connections
-            if (duration >= 60) {
-                printf("Idle Timeout: fd=%d\n", pSocketInfo->fd);
-                // add to list for close
-                socketsToClose.push_back(pSocketInfo);
-                //pCSock->close(true); //unsafe
-            }
-            */
-        }
-    });
+        pSocket->onReadable();
+    }
+    m_readyListRunning.clear();
+}
 
+void EpollReactor::scheduleFlush(SocketContext *pContext)
+{
+    if (pContext->flushScheduled)
+        return;
 
-    //close
-    for (SockInfo* pInfo : socketsToClose) {
-        //
-        TCPSocket* pCSock = static_cast<TCPSocket*>(pInfo->socketBasePtr);
-        if (pCSock) {
-            pCSock->close(true); //safe close
-        }
+    pContext->flushScheduled = true;
+    m_flushList.push_back(pContext->ev.data.u64);
+}
+
+void EpollReactor::runFlushList()
+{
+    std::vector<uint64_t> flushList;
+    flushList.swap(m_flushList);
+    for (uint64_t key : flushList) {
+        SockInfo *pInfo = m_pConnectionList->get(extract_fd(key), extract_gen(key));
+        if (!pInfo || pInfo->type != IS_TCP_SOCKET || !pInfo->socketBasePtr)
+            continue;
+
+        TCPSocket *pSocket = static_cast<TCPSocket*>(pInfo->socketBasePtr);
+        pSocket->getSocketContext()->flushScheduled = false;
+        pSocket->flushCorked();
     }
+}
 
-    //printf("maintenance() Active socket count: %d\n", m_pConnectionList->count());
+void EpollReactor::scheduleMigration(SocketContext *pContext, SocketContext *pPeer, EpollReactor *target)
+{
+    Migration m;
+    m.key = pContext->ev.data.u64;
+    m.peerKey = pPeer ? pPeer->ev.data.u64 : 0;
+    m.hasPeer = pPeer != nullptr;
+    m.target = target;
+    m_migrations.push_back(m);
+}
 
-    /* peymayesh ro socket list ke behine nist
-    std::vector<SockInfo*> *pConnectionListSockets = m_pConnectionList->list();
-    for (SockInfo* sockInfo : *pConnectionListSockets)
-    {
-        if (sockInfo && sockInfo->type == IS_TCP_SOCKET && sockInfo->fd != -1)
-        {
-            TCPSocket* sock = static_cast<TCPSocket*>(sockInfo->socketBasePtr);
-            if (!sock || !sock->getSocketContext()) {
-                continue;
-            }
+void EpollReactor::runMigrations()
+{
+    std::vector<Migration> migrations;
+    migrations.swap(m_migrations);
+
+    //socket e baste shode (close dar callback ha) skip mishe
+    auto lookup = [this](uint64_t key) -> TCPSocket* {
+        SockInfo *pInfo = m_pConnectionList->get(extract_fd(key), extract_gen(key));
+        if (!pInfo || pInfo->type != IS_TCP_SOCKET || !pInfo->socketBasePtr)
+            return nullptr;
+        return static_cast<TCPSocket*>(pInfo->socketBasePtr);
+    };
+
+    for (auto &m : migrations) {
+        TCPSocket *pSocket = lookup(m.key);
+        TCPSocket *pPeer = m.hasPeer ? lookup(m.peerKey) : nullptr;
+        if (pSocket)
+            pSocket->_migrate(m.target, pPeer);
+        else if (pPeer)
+            pPeer->_migrate(m.target, nullptr);
+    }
+}
 
-            // --- منطق اصلی تابع maintenance ---
-            if (sock->getStatus() == TCPSocket::Closing)
-            {
-                auto duration = now - sock->getSocketContext()->lastActive;
-                //
-                if (duration >= WAITING_FOR_CLOSE) {
-                    printf("Timeout for Closing socket: fd=%d\n", sock->fd());
-                    sock->close(true);
-                }
-            }
+uint32_t EpollReactor::rebalanceTo(EpollReactor *target, uint32_t maxMoves)
+{
+    std::vector<TCPSocket*> sockets;
+    m_pConnectionList->forEachActive([&](SockInfo *pInfo) {
+        if (pInfo->type == IS_TCP_SOCKET && pInfo->socketBasePtr)
+            sockets.push_back(static_cast<TCPSocket*>(pInfo->socketBasePtr));
+    });
+
+    //migrateTo socket haye schedule shode ro rad mikone, peer dobare shomorde nemishe
+    uint32_t moved = 0;
+    for (TCPSocket *pSocket : sockets) {
+        if (moved >= maxMoves)
+            break;
+        if (pSocket->relayPeer() && pSocket->migrateTo(target, pSocket->relayPeer()))
+            moved++;
+    }
+
+    //az posted task seda zade mishe, callback i dar jaryan nist: ta epoll_wait e badi sabr nemikonim
+    if (!m_migrations.empty())
+        runMigrations();
+
+    return moved;
+}
+
+void EpollReactor::beginIteration(int eventCount)
+{
+    m_iterationStartNs = monotonicNs();
+    m_telemetry.waits.add(1);
+    if (eventCount > 0)
+        m_telemetry.events.add((uint64_t)eventCount);
+}
+
+void EpollReactor::endOfIteration()
+{
+    if (!m_readyList.empty())
+        runReadyList();
+
+    if (!m_migrations.empty())
+        runMigrations();
+
+    //task haye post shode, yek bar dar har dor
+    if (m_hasPostedTasks)
+        runPostedTasks();
+
+    //auto-cork: har socket yek sendmsg, EPOLLOUT e baghie ham too flushInterest
+    if (!m_flushList.empty())
+        runFlushList();
+
+    //ghabl az epoll_wait e badi
+    if (!m_dirtyInterest.empty())
+        flushInterest();
+
+    //baraye Server (entekhab shard va drain), az thread haye dige khoonde mishe
+    m_publishedConnections.store(m_pConnectionList->count(IS_TCP_SOCKET), std::memory_order_relaxed);
+    //handoff haye accept shode hala too count hastan
+    if (m_handoffsAccepted != 0) {
+        m_pendingHandoffs.fetch_sub(m_handoffsAccepted, std::memory_order_release);
+        m_handoffsAccepted = 0;
+    }
+    m_publishedQueuedBytes.store(m_bufferPool.queuedBytes(), std::memory_order_relaxed);
+    //socket haye entekhab shode ta alan too count hastan
+    if (m_pendingPicks.load(std::memory_order_relaxed) != 0)
+        m_pendingPicks.store(0, std::memory_order_relaxed);
+    m_telemetry.bufferPoolInUse.set(m_bufferPool.bytesInUse());
+    m_telemetry.gcQueueLength.set(m_GCList.size());
+    m_telemetry.recvBufferBytes.set(m_recvBufferBytes);
+    m_telemetry.loopLatency.record(monotonicNs() - m_iterationStartNs);
+}
+
+void EpollReactor::runPostedTasks()
+{
+    m_hasPostedTasks = false;
+
+    //ghabl az drain reset mishe ta post haye jadid dobare wake konan
+    m_wakeupPending.store(false, std::memory_order_release);
+
+    Task tasks[POSTED_TASKS_BATCH];
+    size_t done = 0;
+    size_t count;
+    while (done < POSTED_TASKS_PER_LOOP && (count = m_postedTasks.try_dequeue_bulk(tasks, POSTED_TASKS_BATCH)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            tasks[i]();
+            tasks[i] = nullptr;
         }
+        done += count;
     }
-    */
 
+    //baghie baraye dor e baad, ta I/O gorosne namoone
+    if (done >= POSTED_TASKS_PER_LOOP && !m_wakeupPending.exchange(true, std::memory_order_acq_rel))
+        wake();
 }
 
+
 void EpollReactor::shutdown_all() {
-    /*
-    std::vector <int> fds;
-    fds.reserve(m_ConnectionMap.size());
+    // بسته‌کردن همه‌ی fdها (listener و client)
+    stop_listener();
 
-    for(auto & kv: m_ConnectionMap)
-        fds.push_back(kv.first);
+    //ghabl az close jam mikonim, close active list ro taghir mide
+    std::vector<TCPSocket*> sockets;
+    m_pConnectionList->forEachActive([&](SockInfo* pSocketInfo) {
+        if (pSocketInfo->type == IS_TCP_SOCKET && pSocketInfo->socketBasePtr)
+            sockets.push_back(static_cast<TCPSocket*>(pSocketInfo->socketBasePtr));
+        //dar hale connect (Happy Eyeballs), hanooz fd e khodesh ro nadare
+        if (pSocketInfo->type == IS_CONNECT_ATTEMPT && pSocketInfo->socketBasePtr) {
+            TCPSocket *pOwner = static_cast<HappyEyeballs*>(pSocketInfo->socketBasePtr)->owner();
+            if (std::find(sockets.begin(), sockets.end(), pOwner) == sockets.end())
+                sockets.push_back(pOwner);
+        }
+    });
 
-    for(int fd: fds)
-        close_fd(fd);
-    */
+    for (TCPSocket *pSocket : sockets)
+        pSocket->close(true);
 
-    // بسته‌کردن همه‌ی fdها (listener و client)
-    // اگر SocketList اینترفیس برای enumerate ندارد، نگه‌داشتن لیست fdها لازم است.
-    // فعلاً ساده: rely on process exit یا اضافه‌کردن متد iterate به SocketList.
+    m_publishedConnections.store(0, std::memory_order_relaxed);
 }
 
 
@@ -5,17 +5,28 @@
 #include "clsGCList.h"
 #include "clsSocketList.h"
 #include "clsDNSLookup.h"
+#include "clsTelemetry.h"
+#include "clsTimerManager.h"
 #include "constants.h"
+#include "concurrentqueue.h"
+#include <functional>
+
+// event engine of a shard, selectable per Server
+enum ReactorBackend {
+    BACKEND_EPOLL = 0,
+    BACKEND_IO_URING = 1
+};
 
 // EpollReactor
 //class DNSLookup;
-class TimerManager;
 class UDPSocket;
 class SocketList;
+class UringEngine;
 class EpollReactor
 {
+    friend class UringEngine;
 public:
-    EpollReactor(int id, int maxConnection, int max_events = MAX_EVENTS);
+    EpollReactor(int id, int maxConnection, int max_events = MAX_EVENTS, ReactorBackend backend = BACKEND_EPOLL);
     ~EpollReactor();
 
     // factory from app to create high-level handler for accepted fd
@@ -29,31 +40,122 @@ public:
     void removeFlags(SocketContext *pContext, uint32_t flags);
     void del_fd(int fd, bool removeFromList = false);
     bool add_fd(int fd, epoll_event *pEvent, uint32_t events);
-    bool add_listener(int port);
+    // fastOpenQueue > 0: TCP_FASTOPEN, SYN haye data dar ta in tedad bedoone handshake accept mishan
+    // steerCpus: cpu e har shard (tartib e reuseport group), faghat rooye avalin listener e group
+    bool add_listener(int port, const std::vector<int> &steerCpus = {}, int fastOpenQueue = 0);
+    // listener e handoff shode az process e ghadimi (ghabl az run)
+    bool adoptListener(int listen_fd);
+    static int createListenSocket(int port, int fastOpenQueue = 0);
+    // io_uring: writeQueue e sendmsg e dar jaryan ta completion negah dashte mishe (close(true)),
+    // false = chizi dar jaryan nist, caller khodesh clear kone
+    bool holdInflightSend(SocketContext *pContext);
     void stop_listener();
 
     // accept handoff from accept-thread (18 hot-reload/handoff point)
     void run(std::atomic<bool> &stop);
     void wake();
+    // az har thread ee: fn dar thread e shard ejra mishe (bad az wakeup)
+    using Task = std::function<void()>;
+    void post(Task fn);
     void adoptAccepted(int m_fd);
+    // thread safe: fd e accept shode dar acceptor thread be in shard post mishe
+    void handoffAccepted(int fd);
+    // TCP socket haye shard + handoff haye dar rah + entekhab haye Server, baraye entekhab shard
+    // (listener, timer va DNS socket ha hesab nemishan)
+    uint32_t load() const;
+    // faghat TCP socket ha, baraye drain
+    uint32_t connections() const;
+    // byte haye ersal nashode dar SendQueue haye shard (BufferPool::queuedBytes), har dor update mishe
+    uint64_t queuedBytes() const;
+    // rBuffer haye socket ha (faghat thread e shard): ghesmat e bishtar az RECV_BUFFER_MIN, baraye RECV_BUFFER_BUDGET
+    void noteRecvBuffer(size_t oldCapacity, size_t newCapacity);
+    size_t recvBufferBytes() const;
+    // Server in shard ro entekhab kard, ta publish e badi too load() hesab mishe
+    void notePicked();
+
+    // az thread e shard update mishe, har thread mitoone bekhoone
+    ShardTelemetry *telemetry();
+    const ShardTelemetry *telemetry() const;
+
+    // hot upgrade, dar thread e shard (ba post): listener ha va connection haye
+    // idle (setHandoffIdle) ro ba SCM_RIGHTS mifreste va inja mibande
+    void handoff(int unixSock, bool includeIdleConnections);
     void setUseGarbageCollector(bool newUseGarbageCollector);
     bool getIPbyName(const char *hostname, DNSLookup::callback_t callback, void *p, DNSLookup::QUERY_TYPE QuryType = DNSLookup::A);
+    // query haye dar jaryan e p dige callback nemigiran (ghabl az delete e p)
+    void cancelIPbyName(void *p);
     void deleteLater(TCPSocket* pSockBase);
+    // socket read budget ro tamoom karde, bad az batch dobare onReadable
+    void scheduleRead(SocketContext *pContext);
+    // auto-cork: send() ha queue shodan, akhare dor (ghabl az flushInterest) ersal mishan
+    void scheduleFlush(SocketContext *pContext);
+    // migrateTo: bad az callback haye in dor, socket (va peer, age hast) be target mire
+    void scheduleMigration(SocketContext *pContext, SocketContext *pPeer, EpollReactor *target);
+    // faghat thread e shard: ta maxMoves relay (TCPSocket::relayPeer, do tarafe ba ham) be target mire
+    uint32_t rebalanceTo(EpollReactor *target, uint32_t maxMoves);
     void updateCashedTime();
 
     BufferPool *bufferPool();
+    // timing wheel e shard, baraye timer haye har connection (faghat thread e shard)
+    TimerManager *timers();
+    // default e idle timeout baraye socket haye in shard (TCPSocket::setIdleTimeout override mikone)
+    void setIdleTimeout(int secs);
+    int idleTimeout() const;
 
     uint64_t getCachedNow() const;
+    ReactorBackend backend() const;
+    // cpu e shard thread (-1 = pin nashode), ghabl az add_listener set beshe
+    void setCpu(int cpu);
+    int cpu() const;
+    // BufferPool rooye in NUMA node (bind + prefault)
+    bool setNumaNode(int node);
+    int numaNode() const;
+    // low latency: ta budget_us bad az akharin event spin (timeout 0), bad block
+    // socketBusyPoll: SO_BUSY_POLL/SO_PREFER_BUSY_POLL rooye socket haye jadid
+    void setBusyPoll(int budget_us, bool socketBusyPoll = false);
+    int busyPollSocketUs() const;
 
 private:
     bool m_useGarbageCollector {true};
     int m_reactorID {0};
+    int m_cpu {-1};
+    int m_busyPollBudgetUs {0};     // 0 = disable
+    bool m_busyPollSockets {false};
+    uint64_t m_lastEventNs {0};
     int m_epollSocket {-1};
-    int m_wakeupFd {-1};    //baraye exit safe epoll
+    int m_wakeupFd {-1};    //baraye exit safe epoll va post()
+    std::atomic<bool> m_wakeupPending {false};
+    bool m_hasPostedTasks {false};
+    std::atomic<uint32_t> m_pendingHandoffs {0};    // post shode ta publish e ba'd az accept
+    uint32_t m_handoffsAccepted {0};                // faghat thread e shard, ta publish e badi
+    std::atomic<uint32_t> m_pendingPicks {0};       // entekhab haye Server az publish e ghabli
+    std::atomic<uint32_t> m_publishedConnections {0};
+    std::atomic<uint64_t> m_publishedQueuedBytes {0};
+    std::vector<uint64_t> m_readyList;          // key (fd, genID), socket baste shode skip mishe
+    std::vector<uint64_t> m_readyListRunning;
+    struct Migration {
+        uint64_t key;               // (fd, genID)
+        uint64_t peerKey;           // hasPeer: tarafe dige, dar hamoon task
+        bool hasPeer;
+        EpollReactor *target;
+    };
+    std::vector<Migration> m_migrations;
+    std::vector<uint64_t> m_flushList;          // auto-cork, key (fd, genID)
+    std::vector<uint64_t> m_dirtyInterest;     // addFlags/removeFlags, yek EPOLL_CTL_MOD har socket har dor
+    size_t m_recvBufferBytes {0};
+    ShardTelemetry m_telemetry;
+    uint64_t m_iterationStartNs {0};
+    moodycamel::ConcurrentQueue<Task> m_postedTasks;
     int m_maxEvent {100};
     int m_maxConnection {100};
+    ReactorBackend m_backend {BACKEND_EPOLL};
+    UringEngine *m_pUring {nullptr};
     timespec m_cached_now;
+    int m_idleTimeoutSecs {IDLE_TIMEOUT_SECS};
     TimerManager *m_pTimers;
+    TimerNode m_cachedNowTimer;
+    TimerNode m_dnsTimer;
+    TimerNode m_gcTimer;
 
     std::vector<int> m_listenerList;
     GCList<TCPSocket> m_GCList;
@@ -69,19 +171,29 @@ private:
     //void handle_write(int fd, SocketBase *pSockBase);
 
     void init();
-    void maintenance();
     void shutdown_all();
 
-    // (16) telemetry placeholder; could be atomic counters per shard
     uint64_t make_key(int fd, uint32_t genID);
     int extract_fd(uint64_t key);
     uint32_t extract_gen(uint64_t key);
 
+    void acceptFd(int fd);
+    void dispatchEvent(SockInfo *socketInfo, int fd, uint32_t ev);
     void onTCPEvent(int fd, uint32_t &ev, void *ptr);
     void onUDPEvent(int fd, uint32_t &ev, void *ptr);
     void onTimerEvent(int fd, uint32_t &ev, void *ptr);
     void onTimerManagerEvent(int fd, uint32_t &ev, void *ptr);
     void onDNSEvent(int fd, uint32_t &ev, void *ptr);
+    void onWakeupEvent(int fd, uint32_t &ev);
+    void runPostedTasks();
+    void beginIteration(int eventCount);
+    void endOfIteration();
+    void runReadyList();
+    void runMigrations();
+    void runFlushList();
+    void markInterestDirty(SocketContext *pContext);
+    void flushInterest();
+    int nextWaitTimeout(bool hadEvents, int idleTimeout_ms);
 
     void checkDnsTimeouts();
     void runGarbageCollector();
@@ -66,6 +66,10 @@ public:
         }
     }
 
+    size_t size() const noexcept {
+        return m_qList.size();
+    }
+
     void flush_all() noexcept {
 
          //printf("GC flush_all %d\n", m_qList.size());
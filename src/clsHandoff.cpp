@@ -0,0 +1,138 @@
+#include "clsHandoff.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static bool makeAddress(const char *path, sockaddr_un *pAddr)
+{
+    memset(pAddr, 0, sizeof(*pAddr));
+    pAddr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(pAddr->sun_path)) {
+        printf("handoff: path too long (%s)\n", path);
+        return false;
+    }
+
+    strcpy(pAddr->sun_path, path);
+    return true;
+}
+
+int Handoff::listenAndAccept(const char *path)
+{
+    sockaddr_un addr;
+    if (!makeAddress(path, &addr))
+        return -1;
+
+    int listenFd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        perror("socket(AF_UNIX)");
+        return -1;
+    }
+
+    ::unlink(path);
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(listenFd, 1) < 0) {
+        perror("handoff bind/listen");
+        ::close(listenFd);
+        return -1;
+    }
+
+    printf("handoff: waiting for old process on %s\n", path);
+    int sock;
+    do {
+        sock = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    } while (sock < 0 && errno == EINTR);
+
+    if (sock < 0)
+        perror("handoff accept");
+
+    ::close(listenFd);
+    ::unlink(path);
+    return sock;
+}
+
+int Handoff::connectTo(const char *path)
+{
+    sockaddr_un addr;
+    if (!makeAddress(path, &addr))
+        return -1;
+
+    int sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("socket(AF_UNIX)");
+        return -1;
+    }
+
+    if (::connect(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("handoff connect");
+        ::close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+bool Handoff::sendFd(int sock, Kind kind, int port, int fd)
+{
+    HandoffMsg msg { kind, port };
+    iovec iov { &msg, sizeof(msg) };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+    msghdr mh {};
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+
+    if (fd >= 0) {
+        mh.msg_control = control;
+        mh.msg_controllen = sizeof(control);
+        cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+    }
+
+    ssize_t ret;
+    do {
+        ret = ::sendmsg(sock, &mh, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret != (ssize_t)sizeof(msg)) {
+        perror("handoff sendmsg");
+        return false;
+    }
+
+    return true;
+}
+
+bool Handoff::sendDone(int sock)
+{
+    return sendFd(sock, DONE, 0, -1);
+}
+
+bool Handoff::recvFd(int sock, HandoffMsg *pMsg, int *pFd)
+{
+    iovec iov { pMsg, sizeof(*pMsg) };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] {};
+    msghdr mh {};
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control;
+    mh.msg_controllen = sizeof(control);
+
+    ssize_t ret;
+    do {
+        ret = ::recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret != (ssize_t)sizeof(*pMsg))
+        return false;
+
+    *pFd = -1;
+    cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+        memcpy(pFd, CMSG_DATA(cm), sizeof(int));
+
+    return true;
+}
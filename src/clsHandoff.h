@@ -0,0 +1,33 @@
+#ifndef CLSHANDOFF_H
+#define CLSHANDOFF_H
+// ============================== Handoff (hot upgrade) =======================
+// Listener va connection fd ha ba SCM_RIGHTS rooye unix SOCK_SEQPACKET be
+// process e jadid ersal mishan. har message yek fd + HandoffMsg.
+#include <cstdint>
+
+class Handoff
+{
+public:
+    enum Kind : uint32_t {
+        LISTENER = 1,
+        CONNECTION = 2,
+        DONE = 3
+    };
+
+    struct HandoffMsg {
+        uint32_t kind;
+        int32_t port;   // listener: port, connection: 0
+    };
+
+    // process e jadid: listen rooye path, ta connect e process e ghadimi block mikone
+    static int listenAndAccept(const char *path);
+    // process e ghadimi
+    static int connectTo(const char *path);
+
+    static bool sendFd(int sock, Kind kind, int port, int fd);
+    static bool sendDone(int sock);
+    // fd = -1 baraye DONE, false yani error ya peer baste shode
+    static bool recvFd(int sock, HandoffMsg *pMsg, int *pFd);
+};
+
+#endif // CLSHANDOFF_H
@@ -0,0 +1,314 @@
+#include "clsHappyEyeballs.h"
+#include "clsEpollReactor.h"
+#include "clsSendQueue.h"
+#include "clsTCPSocket.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+static uint64_t monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+HappyEyeballs::HappyEyeballs(TCPSocket *owner, EpollReactor *reactor, uint16_t port)
+    : m_pOwner(owner), m_pReactor(reactor), m_port(port)
+{
+    m_startNs = monotonicNs();
+}
+
+HappyEyeballs::~HappyEyeballs()
+{
+    //query e family e dige (masalan AAAA bad az barande shodan e A) ta retry/timeout pending mimoone,
+    //user_data owner e ke momkene GC delete kone
+    if (m_waitA || m_waitAAAA)
+        m_pReactor->cancelIPbyName(m_pOwner);
+    closeAttempts();
+    m_pReactor->timers()->stop(&m_attemptTimer);
+    m_pReactor->timers()->stop(&m_resolutionTimer);
+}
+
+void HappyEyeballs::expect(bool a, bool aaaa)
+{
+    m_waitA = a;
+    m_waitAAAA = aaaa;
+}
+
+void HappyEyeballs::setFastOpen(bool enable)
+{
+    m_fastOpen = enable;
+}
+
+void HappyEyeballs::onResolved(DNSLookup::QUERY_TYPE query, char **ips, size_t count)
+{
+    //javab e tekrari (masalan khata ba callback va return false)
+    bool &waiting = query == DNSLookup::AAAA ? m_waitAAAA : m_waitA;
+    if (!waiting)
+        return;
+    waiting = false;
+
+    for (size_t i = 0; i < count; i++)
+        addAddress(ips[i]);
+
+    //A zoodtar az AAAA: kami montazer ta IPv6 aval bashe
+    if (query == DNSLookup::A && m_waitAAAA && m_attempts.empty() && count > 0) {
+        m_resolutionDelay = true;
+        m_pReactor->timers()->start(&m_resolutionTimer, HE_RESOLUTION_DELAY_MS, onResolutionDelay, this, true);
+        return;
+    }
+
+    if (m_resolutionDelay) {
+        m_resolutionDelay = false;
+        m_pReactor->timers()->stop(&m_resolutionTimer);
+    }
+
+    //timer e attempt hanooz faal e: address haye jadid nobat e khodeshoon
+    if (!m_attempts.empty() && m_attemptTimer.isActive())
+        return;
+
+    next();
+}
+
+void HappyEyeballs::onAttemptEvent(int fd, uint32_t events)
+{
+    size_t index = 0;
+    while (index < m_attempts.size() && m_attempts[index].fd != fd)
+        index++;
+    if (index == m_attempts.size())
+        return;
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err == 0 && (events & (EPOLLERR | EPOLLHUP)))
+        err = ECONNREFUSED;
+    if (err == 0 && !(events & EPOLLOUT))
+        return;
+
+    if (err != 0) {
+        printf("connect attempt failed: %s\n", strerror(err));
+        m_lastError = err;
+        closeAttempt(index);
+        //shekast: attempt e badi bedoone montazer e timer
+        m_pReactor->timers()->stop(&m_attemptTimer);
+        next();
+        return;
+    }
+
+    //barande az reactor kharej mishe, TCPSocket ba type e khodesh register mikone
+    m_winner = m_attempts[index].address;
+    m_winnerSynBytes = m_attempts[index].synBytes;
+    m_pReactor->del_fd(fd, true);
+    m_attempts.erase(m_attempts.begin() + index);
+    finish(fd, 0);
+}
+
+TCPSocket *HappyEyeballs::owner() const
+{
+    return m_pOwner;
+}
+
+uint64_t HappyEyeballs::elapsedNs() const
+{
+    return monotonicNs() - m_startNs;
+}
+
+const sockaddr_storage &HappyEyeballs::winnerAddress() const
+{
+    return m_winner.addr;
+}
+
+socklen_t HappyEyeballs::winnerAddressLength() const
+{
+    return m_winner.len;
+}
+
+size_t HappyEyeballs::fastOpenBytes() const
+{
+    return m_winnerSynBytes;
+}
+
+void HappyEyeballs::addAddress(const char *ip)
+{
+    Address address {};
+    sockaddr_in6 &v6 = reinterpret_cast<sockaddr_in6&>(address.addr);
+    sockaddr_in &v4 = reinterpret_cast<sockaddr_in&>(address.addr);
+    std::vector<Address> *list;
+    if (inet_pton(AF_INET6, ip, &v6.sin6_addr) == 1) {
+        v6.sin6_family = AF_INET6;
+        v6.sin6_port = htons(m_port);
+        address.len = sizeof(v6);
+        list = &m_v6;
+    } else if (inet_pton(AF_INET, ip, &v4.sin_addr) == 1) {
+        v4.sin_family = AF_INET;
+        v4.sin_port = htons(m_port);
+        address.len = sizeof(v4);
+        list = &m_v4;
+    } else {
+        printf("invalid address [%s]\n", ip);
+        return;
+    }
+
+    //cache momkene hamoon list ro baraye har do query bede
+    for (const Address &a : *list) {
+        if (a.len == address.len && memcmp(&a.addr, &address.addr, address.len) == 0)
+            return;
+    }
+    list->push_back(address);
+}
+
+bool HappyEyeballs::popAddress(Address &out)
+{
+    bool v6Left = m_nextV6Index < m_v6.size();
+    bool v4Left = m_nextV4Index < m_v4.size();
+    if (!v6Left && !v4Left)
+        return false;
+
+    //family ha yeki dar miyoon, IPv6 aval
+    if (v4Left && (m_nextV4 || !v6Left)) {
+        out = m_v4[m_nextV4Index++];
+        m_nextV4 = false;
+    } else {
+        out = m_v6[m_nextV6Index++];
+        m_nextV4 = true;
+    }
+    return true;
+}
+
+void HappyEyeballs::next()
+{
+    Address address;
+    while (popAddress(address)) {
+        if (startAttempt(address))
+            return;
+    }
+
+    //attempt ya query e dige mimoone: montazer
+    if (!m_attempts.empty() || m_waitA || m_waitAAAA || m_resolutionDelay)
+        return;
+
+    finish(-1, m_lastError);
+}
+
+bool HappyEyeballs::startAttempt(const Address &address)
+{
+    char ip[INET6_ADDRSTRLEN] = {0};
+    if (address.addr.ss_family == AF_INET6)
+        inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(address.addr).sin6_addr, ip, sizeof(ip));
+    else
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(address.addr).sin_addr, ip, sizeof(ip));
+    printf("connecting to (%s:%d)...\n", ip, m_port);
+
+    int fd = ::socket(address.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (fd == -1) {
+        m_lastError = errno;
+        perror("socket creation failed");
+        return false;
+    }
+
+    TCPSocket::setSocketNoDelay(fd, true);
+    TCPSocket::setSocketResourceAddress(fd, true);
+    if (m_pReactor->busyPollSocketUs() > 0)
+        TCPSocket::setSocketBusyPoll(fd, m_pReactor->busyPollSocketUs());
+
+    //bedoone early data TFO faydei nadare (SYN ta avalin write defer mishe)
+    SendQueue *pEarlyData = m_pOwner->getSocketContext()->writeQueue;
+    bool fastOpen = m_fastOpen && !m_synDataSent && pEarlyData && !pEarlyData->empty()
+            && TCPSocket::setSocketFastOpenConnect(fd, true);
+
+    size_t synBytes = 0;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address.addr), address.len) == 0) {
+        if (!fastOpen) {
+            // اتصال فوری موفق (نادر اما ممکن)
+            m_winner = address;
+            finish(fd, 0);
+            return true;
+        }
+
+        //cookie dasht: connect defer shod, SYN inja ba data
+        //(bedoone cookie connect() mesle hamishe EINPROGRESS, early data bad az connect)
+        if (!sendSynData(fd, synBytes)) {
+            m_lastError = errno;
+            ::close(fd);
+            return false;
+        }
+    } else if (errno != EINPROGRESS) {
+        m_lastError = errno;
+        ::close(fd);
+        return false;
+    }
+
+    struct epoll_event ev {};
+    ev.events = EPOLLOUT;
+    if (!m_pReactor->register_fd(fd, &ev, IS_CONNECT_ATTEMPT, this)) {
+        m_lastError = EMFILE;
+        m_pReactor->del_fd(fd, true);
+        ::close(fd);
+        return false;
+    }
+
+    m_attempts.push_back({fd, address, synBytes});
+    m_pReactor->timers()->start(&m_attemptTimer, HE_ATTEMPT_DELAY_MS, onAttemptDelay, this, true);
+    return true;
+}
+
+bool HappyEyeballs::sendSynData(int fd, size_t &synBytes)
+{
+    //faghat chunk e aval, kernel bishtar az MSS dar SYN nemizare
+    struct iovec iov;
+    size_t bytes = 0;
+    m_pOwner->getSocketContext()->writeQueue->fillIov(&iov, 1, 0, bytes);
+
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    while (true) {
+        ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n >= 0) {
+            synBytes = (size_t)n;
+            m_synDataSent = n > 0;
+            return true;
+        }
+
+        //SYN raft vali data na (cookie ghabool nashod), bad az connect ersal mishe
+        if (errno == EINPROGRESS)
+            return true;
+        if (errno != EINTR)
+            return false;
+    }
+}
+
+void HappyEyeballs::closeAttempt(size_t index)
+{
+    int fd = m_attempts[index].fd;
+    m_pReactor->del_fd(fd, true);
+    ::close(fd);
+    m_attempts.erase(m_attempts.begin() + index);
+}
+
+void HappyEyeballs::closeAttempts()
+{
+    while (!m_attempts.empty())
+        closeAttempt(m_attempts.size() - 1);
+}
+
+void HappyEyeballs::finish(int fd, int err)
+{
+    closeAttempts();
+    m_pReactor->timers()->stop(&m_attemptTimer);
+    m_pReactor->timers()->stop(&m_resolutionTimer);
+    m_pOwner->_connected(fd, err);
+}
+
+void HappyEyeballs::onAttemptDelay(void *p)
+{
+    static_cast<HappyEyeballs*>(p)->next();
+}
+
+void HappyEyeballs::onResolutionDelay(void *p)
+{
+    HappyEyeballs *pEyeballs = static_cast<HappyEyeballs*>(p);
+    pEyeballs->m_resolutionDelay = false;
+    pEyeballs->next();
+}
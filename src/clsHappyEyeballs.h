@@ -0,0 +1,85 @@
+#ifndef CLSHAPPYEYEBALLS_H
+#define CLSHAPPYEYEBALLS_H
+#include "clsDNSLookup.h"
+#include "clsTimerManager.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <vector>
+
+class EpollReactor;
+class TCPSocket;
+// Happy Eyeballs (RFC 8305) baraye TCPSocket::connectTo: A va AAAA ba ham resolve mishan,
+// connect ha ba fasele HE_ATTEMPT_DELAY_MS (IPv6 aval, family ha yeki dar miyoon) mosabeghe midan,
+// avalin connect e movafagh barande va baghie baste mishan. natije ba TCPSocket::_connected().
+// #mohem: _connected() akharin kar e har method e, owner mitoone hamoonja in object ro delete kone
+class HappyEyeballs {
+public:
+    HappyEyeballs(TCPSocket *owner, EpollReactor *reactor, uint16_t port);
+    ~HappyEyeballs();
+
+    // query haye ke natijashoon miad (ip literal faghat yeki)
+    void expect(bool a, bool aaaa);
+    // early data e owner (writeQueue) ba SYN (TCP_FASTOPEN_CONNECT), faghat yek attempt
+    void setFastOpen(bool enable);
+    // query = family e darkhast (cache momkene family e dige bede), count 0 = khata
+    void onResolved(DNSLookup::QUERY_TYPE query, char **ips, size_t count);
+    // EPOLLOUT/EPOLLERR e yek attempt (IS_CONNECT_ATTEMPT)
+    void onAttemptEvent(int fd, uint32_t events);
+
+    TCPSocket *owner() const;
+    // az connectTo ta alan
+    uint64_t elapsedNs() const;
+    // address e attempt e barande, baraye peerAddr
+    const sockaddr_storage &winnerAddress() const;
+    socklen_t winnerAddressLength() const;
+    // byte haye aval e writeQueue e owner ke ba SYN e barande raftan, owner consume mikone
+    size_t fastOpenBytes() const;
+
+private:
+    struct Address {
+        sockaddr_storage addr;
+        socklen_t len;
+    };
+    struct Attempt {
+        int fd;
+        Address address;
+        size_t synBytes;        // early data dakhele SYN
+    };
+
+    TCPSocket *m_pOwner;
+    EpollReactor *m_pReactor;
+    uint16_t m_port;
+    uint64_t m_startNs;
+    bool m_waitA { false };
+    bool m_waitAAAA { false };
+    bool m_resolutionDelay { false };   // A omad, ta HE_RESOLUTION_DELAY_MS montazer e AAAA
+    bool m_nextV4 { false };            // family e attempt e badi
+    bool m_fastOpen { false };
+    bool m_synDataSent { false };       // early data faghat ba yek attempt (server momkene har do ro begire)
+    int m_lastError { EHOSTUNREACH };
+    std::vector<Address> m_v6;
+    std::vector<Address> m_v4;
+    size_t m_nextV6Index { 0 };
+    size_t m_nextV4Index { 0 };
+    std::vector<Attempt> m_attempts;    // fd haye dar hale connect
+    Address m_winner {};
+    size_t m_winnerSynBytes { 0 };
+    TimerNode m_attemptTimer;
+    TimerNode m_resolutionTimer;
+
+    void addAddress(const char *ip);
+    bool popAddress(Address &out);
+    // attempt e badi; hich address/attempt/query namoonde = shekast
+    void next();
+    // false = in address connect nashod (m_lastError)
+    bool startAttempt(const Address &address);
+    // connect e defer shode (TFO ba cookie): SYN ba avalin chunk e writeQueue, false = khata (errno)
+    bool sendSynData(int fd, size_t &synBytes);
+    void closeAttempt(size_t index);
+    void closeAttempts();
+    void finish(int fd, int err);
+    static void onAttemptDelay(void *p);
+    static void onResolutionDelay(void *p);
+};
+
+#endif // CLSHAPPYEYEBALLS_H
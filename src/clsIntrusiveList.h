@@ -33,6 +33,11 @@ public:
     IntrusiveList& operator=(const IntrusiveList&) = delete;
 
     size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+
+    T* front() {
+        return m_head.next == &m_head ? nullptr : getObjectFromLink(m_head.next);
+    }
 
     /**
      * @brief اضافه کردن شیء به انتهای لیست. O(1) و بدون تخصیص حافظه
@@ -7,58 +7,6 @@
 #include "clsEpollReactor.h"
 
 
-bool MultiplexedTunnel::initParseBuffer() {
-    if (m_parseBuffer)
-        return true;
-    /**/
-    //m_SocketContext.rBuffer = (char*)m_pReactor->bufferPool()->allocate(SLAB_SIZE);
-    if (getReactor() && getReactor()->bufferPool()) {
-        m_parseBuffer = (uint8_t*)getReactor()->bufferPool()->allocate(PARSE_BUFFER_SIZE);
-        if (m_parseBuffer) {
-            m_parseBufferCapacity = PARSE_BUFFER_SIZE;
-            m_parseBufferLength = 0;
-            return true;
-        }
-    }
-
-    m_parseBuffer = nullptr;
-    m_parseBufferCapacity = 0;
-    return false;
-}
-
-void MultiplexedTunnel::releaseParseBuffer() {
-    /**/
-    if (m_parseBuffer) {
-        if (getReactor() && getReactor()->bufferPool()) {
-            getReactor()->bufferPool()->deallocate(m_parseBuffer);
-        }
-        m_parseBuffer = nullptr;
-        m_parseBufferCapacity = 0;
-        m_parseBufferLength = 0;
-    }
-
-}
-
-bool MultiplexedTunnel::resizeParseBuffer(size_t newCapacity) {
-    if (newCapacity <= m_parseBufferCapacity)
-        return true;
-
-    if (getReactor() && getReactor()->bufferPool()) {
-        void* newBuf = getReactor()->bufferPool()->reallocate(m_parseBuffer, newCapacity);
-
-        if (newBuf) {
-            m_parseBuffer = (uint8_t*)newBuf;
-            m_parseBufferCapacity = newCapacity;
-            printf("Parse buffer resized to %zu bytes.\n", newCapacity);
-            return true;
-        } else {
-            // Reallocation failed
-            printf("Error: Parse buffer reallocation failed for size %zu.\n", newCapacity);
-        }
-    }
-    return false;
-}
-
 bool MultiplexedTunnel::initSendQueue(Stream& session) {
     if (session.pendingData) {
         return true;
@@ -87,14 +35,11 @@ bool MultiplexedTunnel::initSendQueue(Stream& session) {
 
 MultiplexedTunnel::MultiplexedTunnel(bool isClient) :
     m_isClient(isClient),
-    m_nextStreamId(isClient ? 1 : 2),
-    m_parseBufferLength(0),
-    m_parseBufferCapacity(0)
+    m_nextStreamId(isClient ? 1 : 2)
 {
 }
 
 MultiplexedTunnel::~MultiplexedTunnel() {
-    releaseParseBuffer();
 }
 
 void MultiplexedTunnel::setOnNewStream(OnNewStreamFn fn, void* arg) {
@@ -261,9 +206,9 @@ void MultiplexedTunnel::sendFrame(FrameType type, FrameFlags flags, uint32_t str
     uint32_t netLength = htonl(length);
     memcpy(header + 8, &netLength, 4);
 
-    send(header, HEADER_SIZE);
-    if (length > 0 && payload)
-        send(payload, length);
+    //header va payload ba ham, yek syscall baraye har frame
+    struct iovec iov[2] = {{header, HEADER_SIZE}, {const_cast<uint8_t*>(payload), length}};
+    send(iov, (length > 0 && payload) ? 2 : 1);
 }
 
 
@@ -327,28 +272,14 @@ void printHexDump(const std::string& data) {
     std::cout << std::dec;
 }
 
-void MultiplexedTunnel::onReceiveData(const uint8_t* data, size_t len) {
+size_t MultiplexedTunnel::onReceiveData(const uint8_t* data, size_t len) {
 
     size_t data_pos = 0;
 
-    // 1. تکمیل فریم ناقص قبلی
-    if (m_parseBufferLength > 0) {
-        if (!initParseBuffer()) {
-            shutdown(GoAwayCode::InternalError);
-            return;
-        }
-
-        // اگر تکمیل و پردازش فریم Fragment شده موفقیت‌آمیز نبود، تابع به دلیل نیاز به داده بیشتر برمی‌گردد.
-        if (!processFragmentedFrame(data, len, data_pos)) {
-            return;
-        }
-    }
-
-    // 2. پردازش Zero-Copy Streaming روی باقیمانده داده ورودی
+    // پردازش Zero-Copy روی rBuffer سوکت، فریم ناقص آخر در rBuffer می‌ماند
     processZeroCopyFrames(data, len, data_pos);
 
-    // 3. ذخیره فریم ناقص نهایی
-    storeRemainingData(data, len, data_pos);
+    return data_pos;
 }
 
 bool MultiplexedTunnel::processFrame(const uint8_t* frameStart, size_t totalFrameSize, uint32_t payloadLength) {
@@ -402,69 +333,6 @@ bool MultiplexedTunnel::processFrame(const uint8_t* frameStart, size_t totalFram
     return true;
 }
 
-size_t MultiplexedTunnel::processFragmentedFrame(const uint8_t* data, size_t len, size_t& data_pos) {
-
-    // 1. تکمیل هدر (در صورت نیاز)
-    if (m_parseBufferLength < HEADER_SIZE) {
-        size_t neededForHeader = HEADER_SIZE - m_parseBufferLength;
-        size_t copyLen = std::min(neededForHeader, len - data_pos);
-
-        memcpy(m_parseBuffer + m_parseBufferLength, data + data_pos, copyLen);
-        m_parseBufferLength += copyLen;
-        data_pos += copyLen;
-
-        if (m_parseBufferLength < HEADER_SIZE) {
-            return false; // هدر هنوز کامل نشده
-        }
-    }
-
-    // 2. تعیین طول فریم کامل
-    uint32_t netLength;
-    memcpy(&netLength, m_parseBuffer + 8, 4);
-    uint32_t payloadLength = ntohl(netLength);
-    uint8_t type_val = m_parseBuffer[1];
-
-    size_t totalFrameSize = HEADER_SIZE;
-    if (type_val == static_cast<uint8_t>(FrameType::Data)) {
-        totalFrameSize += payloadLength;
-    }
-
-    // 3. بررسی ظرفیت (با فرض ** عدم تغییر سایز بافر در حال حاضر**)
-    if (m_parseBufferCapacity < totalFrameSize) {
-        if (totalFrameSize > MAX_ALLOWED_FRAME_SIZE) {
-            printf("Protocol Error: Frame size %zu exceeds max allowed limit.\n", totalFrameSize);
-            shutdown(GoAwayCode::ProtocolError);
-            return false;
-        }
-
-        if (!resizeParseBuffer(totalFrameSize)) {
-            shutdown(GoAwayCode::InternalError);
-            return false;
-        }
-    }
-
-    // 4. تکمیل Payload (در صورت نیاز)
-    size_t neededForFrame = totalFrameSize - m_parseBufferLength;
-    if (neededForFrame > 0) {
-        size_t remainingInput = len - data_pos;
-        size_t copyLen = std::min(neededForFrame, remainingInput);
-
-        memcpy(m_parseBuffer + m_parseBufferLength, data + data_pos, copyLen);
-        m_parseBufferLength += copyLen;
-        data_pos += copyLen;
-
-        if (m_parseBufferLength < totalFrameSize) {
-            return false; // فریم کامل نشد
-        }
-    }
-
-    // 5. پردازش فریم کامل شده
-    bool success = processFrame(m_parseBuffer, totalFrameSize, payloadLength);
-    m_parseBufferLength = 0; // خالی کردن بافر Fragment
-
-    return success;
-}
-
 void MultiplexedTunnel::processZeroCopyFrames(const uint8_t* data, size_t len, size_t& data_pos) {
     const uint8_t* currentDataPtr = data + data_pos;
     size_t currentLen = len - data_pos;
@@ -484,12 +352,20 @@ void MultiplexedTunnel::processZeroCopyFrames(const uint8_t* data, size_t len, s
             totalFrameSize += payloadLength;
         }
 
+        if (totalFrameSize > MAX_ALLOWED_FRAME_SIZE + HEADER_SIZE) {
+            printf("Protocol Error: Frame size %zu exceeds max allowed limit.\n", totalFrameSize);
+            shutdown(GoAwayCode::ProtocolError);
+            data_pos = len;
+            return;
+        }
+
         if (pos + totalFrameSize > currentLen) {
-            break; // داده ناقص است، برای ذخیره‌سازی Fragment آماده می‌شویم.
+            break; // داده ناقص است، باقیمانده در rBuffer سوکت می‌ماند.
         }
 
         // پردازش فریم با Zero-Copy
         if (!processFrame(currentDataPtr + pos, totalFrameSize, payloadLength)) {
+            data_pos = len;
             return; // خطای پروتکلی، پردازش متوقف می‌شود.
         }
 
@@ -498,30 +374,6 @@ void MultiplexedTunnel::processZeroCopyFrames(const uint8_t* data, size_t len, s
     data_pos += pos; // به‌روزرسانی پوزیشن خوانده شده از بافر ورودی
 }
 
-void MultiplexedTunnel::storeRemainingData(const uint8_t* data, size_t len, size_t data_pos) {
-    size_t remaining = len - data_pos;
-
-    if (remaining > 0) {
-        // یک فریم ناقص مانده است. باید در m_parseBuffer ذخیره شود.
-        if (!m_parseBuffer) {
-            if (!initParseBuffer()) {
-                shutdown(GoAwayCode::InternalError);
-                return;
-            }
-        }
-
-        if (remaining > m_parseBufferCapacity) {
-            // این حالت نشان‌دهنده دریافت یک بلوک داده بزرگتر از انتظار است.
-            shutdown(GoAwayCode::InternalError);
-            return;
-        }
-
-        // کپی باقیمانده به m_parseBuffer
-        memcpy(m_parseBuffer, data + data_pos, remaining);
-        m_parseBufferLength = remaining;
-    }
-}
-
 void MultiplexedTunnel::handleNewStream(uint32_t streamId, uint16_t flags)
 {
     if (!(flags & FrameFlags::SYN))
@@ -670,19 +522,15 @@ void MultiplexedTunnel::processPending(uint32_t streamId) {
     while (!s.pendingData->empty() && s.sendWindow > 0) {
         //printf("processPending sendWindow is 0, stream %u. Pending size: %zu\n", streamId, s.pendingData->count());
 
-        SendQueue::Buffer& buf = s.pendingData->front();
-        uint32_t chunk = std::min<uint32_t>((uint32_t)buf.len, s.sendWindow);
+        struct iovec buf;
+        size_t bytes = 0;
+        s.pendingData->fillIov(&buf, 1, s.sendWindow, bytes);
+        uint32_t chunk = std::min<uint32_t>((uint32_t)buf.iov_len, s.sendWindow);
 
-        sendFrame(FrameType::Data, FrameFlags(0), streamId, chunk, (const uint8_t*)buf.data);
+        sendFrame(FrameType::Data, FrameFlags(0), streamId, chunk, (const uint8_t*)buf.iov_base);
         s.sendWindow -= chunk;
 
-        if (chunk < buf.len) {
-            // Partial send
-            memmove(buf.data, (char*)buf.data + chunk, buf.len - chunk);
-            buf.len -= chunk;
-            break;
-        }
-        // Entire buffer sent
-        s.pendingData->pop_front();
+        // Partial send: faghat offset e chunk jolo mire
+        s.pendingData->consume(chunk);
     }
 }
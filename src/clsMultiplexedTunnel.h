@@ -14,8 +14,8 @@ constexpr uint32_t HEADER_SIZE = 12;
 constexpr uint32_t INITIAL_WINDOW_SIZE = 256 * 1024;
 constexpr uint32_t WINDOW_UPDATE_THRESHOLD = 8 * 1024;   //INITIAL_WINDOW_SIZE / 2;
 constexpr uint32_t BACK_PRESSURE_LIMIT = 4 * 1024 * 1024;
-constexpr size_t PARSE_BUFFER_SIZE = 8 * 1024;
 constexpr size_t MAX_ALLOWED_FRAME_SIZE = 128 * 1024;
+static_assert(MAX_ALLOWED_FRAME_SIZE + HEADER_SIZE < RECV_BUFFER_MAX, "frame e naghes bayad too rBuffer e socket ja beshe");
 
 // Frame types
 enum class FrameType : uint8_t {
@@ -90,7 +90,7 @@ public:
     void setOnNewStream(OnNewStreamFn fn, void* arg);
 
     // Override to handle multiplexing
-    void onReceiveData(const uint8_t* data, size_t len) override;
+    size_t onReceiveData(const uint8_t* data, size_t len) override;
 
     void shutdown(GoAwayCode code = GoAwayCode::Normal);
 
@@ -115,20 +115,10 @@ private:
     void* m_newStreamArg = nullptr;
 
     //
-    uint8_t* m_parseBuffer = nullptr;
-    size_t m_parseBufferLength = 0;
-    size_t m_parseBufferCapacity = 0;
-
-    //
-    bool initParseBuffer();
-    void releaseParseBuffer();
-    bool resizeParseBuffer(size_t newCapacity);
     bool initSendQueue(Stream& session);   //Lazy Initialization
 
     bool processFrame(const uint8_t* frameStart, size_t totalFrameSize, uint32_t payloadLength);
-    size_t processFragmentedFrame(const uint8_t* data, size_t len, size_t& data_pos);
     void processZeroCopyFrames(const uint8_t* data, size_t len, size_t& data_pos);
-    void storeRemainingData(const uint8_t* data, size_t len, size_t data_pos);
 
 };
 
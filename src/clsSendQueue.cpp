@@ -1,9 +1,13 @@
 #include "clsSendQueue.h"
+#include <algorithm>
 #include <cstdio>
 #include <unistd.h>
 
 
 SendQueue::SendQueue(BufferPool &pool) : m_pool(pool) {
+    m_head = m_tail = nullptr;
+    m_heldHead = m_heldTail = nullptr;
+    m_spare = nullptr;
     m_len = 0;
 }
 
@@ -12,61 +16,186 @@ SendQueue::~SendQueue() {
 }
 
 void SendQueue::push(const void *data, size_t len) {
-    void* buf = m_pool.allocate(len);
-    if(buf){
-        memcpy(buf, data, len);
-        m_queue.push_back({buf, len});
-        m_len += len;
-        //printf("SendQueue::push: [%zu] size[%zuKB]\n", len, m_len / 1024);//m_queue.size()
-    }else{
-        printf("SendQueue::push: can not allocate\n");
-        //sleep(1);
+    const char* src = static_cast<const char*>(data);
+    while (len > 0) {
+        //chunk e pinned ham append mishe, kernel faghat byte haye ersal shode ro mikhoone
+        Chunk* tail = m_tail;
+        if (!tail || tail->slab || tail->end == CHUNK_CAPACITY) {
+            tail = newChunk();
+            if (!tail) {
+                printf("SendQueue::push: can not allocate\n");
+                return;
+            }
+        }
+
+        size_t n = std::min<size_t>(len, CHUNK_CAPACITY - tail->end);
+        memcpy(tail->base + tail->end, src, n);
+        tail->end += (uint32_t)n;
+        m_len += n;
+        m_pool.addQueued(n);
+        src += n;
+        len -= n;
     }
 }
 
-bool SendQueue::empty() const {
-    return m_queue.empty();
+SendQueue::Chunk *SendQueue::newChunk() {
+    Chunk* chunk = m_spare;
+    m_spare = nullptr;
+    if (!chunk) {
+        chunk = static_cast<Chunk*>(m_pool.allocate(SEND_CHUNK_SIZE));
+        if (!chunk)
+            return nullptr;
+    }
+
+    chunk->base = reinterpret_cast<char*>(chunk + 1);
+    chunk->slab = nullptr;
+    chunk->begin = chunk->end = 0;
+    link(chunk);
+    return chunk;
+}
+
+void SendQueue::pushShared(void *slab, const void *data, size_t len) {
+    if (len == 0)
+        return;
+
+    //faghat header allocate mishe
+    Chunk* chunk = static_cast<Chunk*>(m_pool.allocate(sizeof(Chunk)));
+    if (!chunk) {
+        push(data, len);
+        return;
+    }
+
+    m_pool.retain(slab);
+    chunk->base = static_cast<char*>(const_cast<void*>(data));
+    chunk->slab = slab;
+    chunk->begin = 0;
+    chunk->end = (uint32_t)len;
+    link(chunk);
+    m_len += len;
+    m_pool.addQueued(len);
+}
+
+void SendQueue::link(Chunk *chunk) {
+    chunk->next = nullptr;
+    chunk->seq = 0;
+    chunk->pinned = false;
+
+    if (m_tail)
+        m_tail->next = chunk;
+    else
+        m_head = chunk;
+    m_tail = chunk;
 }
 
-void SendQueue::pop_front() {
-    if (!m_queue.empty()) {
+void SendQueue::freeChunk(Chunk *chunk) {
+    if (chunk->slab)
+        m_pool.release(chunk->slab);
+    m_pool.deallocate(chunk);
+}
+
+bool SendQueue::empty() const {
+    return m_head == nullptr;
+}
 
-        m_len -= m_queue.front().len;
-        //printf("SendQueue::pop_front(): [%zu]\n", m_len);
-        m_pool.deallocate(m_queue.front().data);    //segment fault
-        m_queue.pop_front();
+size_t SendQueue::fillIov(iovec *iov, size_t maxIov, size_t maxBytes, size_t &bytes) const {
+    size_t count = 0;
+    bytes = 0;
+    for (const Chunk* chunk = m_head; chunk && count < maxIov; chunk = chunk->next) {
+        size_t len = chunk->end - chunk->begin;
+        if (count > 0 && bytes + len > maxBytes)
+            break;
 
-    }else{
-        printf("pop_front empty\n");
+        iov[count].iov_base = chunk->base + chunk->begin;
+        iov[count].iov_len = len;
+        bytes += len;
+        count++;
     }
+    return count;
 }
 
-void SendQueue::clear() {
-    while (!m_queue.empty()) {
-        pop_front();
+void SendQueue::copyTo(std::string &out) const {
+    for (const Chunk* chunk = m_head; chunk; chunk = chunk->next)
+        out.append(chunk->base + chunk->begin, chunk->end - chunk->begin);
+}
+
+void SendQueue::consume(size_t len, bool zeroCopy, uint32_t seq) {
+    while (len > 0 && m_head) {
+        Chunk* chunk = m_head;
+        size_t available = chunk->end - chunk->begin;
+        if (len >= available) {
+            len -= available;
+            //kernel hanooz az chunk mikhoone, ta completion e akharin seq
+            popFront(zeroCopy || chunk->pinned, seq);
+        } else {
+            //bedoone memmove: ba MSG_ZEROCOPY page ha pin hastan
+            if (zeroCopy)
+                chunk->pinned = true;
+            chunk->begin += (uint32_t)len;
+            m_len -= len;
+            m_pool.subQueued(len);
+            len = 0;
+        }
     }
 }
 
-size_t SendQueue::size() const {
-    //printf("SendQueue::size(): [%zu]\n", m_queue.size());
-    return m_len;
+void SendQueue::popFront(bool hold, uint32_t seq) {
+    Chunk* chunk = m_head;
+    m_head = chunk->next;
+    if (!m_head)
+        m_tail = nullptr;
+    m_len -= chunk->end - chunk->begin;
+    m_pool.subQueued(chunk->end - chunk->begin);
+    chunk->next = nullptr;
+
+    if (hold) {
+        chunk->seq = seq;
+        if (m_heldTail)
+            m_heldTail->next = chunk;
+        else
+            m_heldHead = chunk;
+        m_heldTail = chunk;
+    } else if (m_head && !m_spare && !chunk->slab) {
+        //stream e ersal dar jarian: tail e badi hamin chunk mishe
+        m_spare = chunk;
+    } else {
+        freeChunk(chunk);
+    }
+
+    //socket e idle chunk negah nemidare
+    if (!m_head && m_spare) {
+        freeChunk(m_spare);
+        m_spare = nullptr;
+    }
 }
 
-size_t SendQueue::count() const {
-    return m_queue.size();
+void SendQueue::clear() {
+    while (m_head)
+        popFront(false, 0);
+
+    //close: page ha pin hastan, reuse faghat data e ersal nashode ro kharab mikone
+    while (m_heldHead) {
+        Chunk* chunk = m_heldHead;
+        m_heldHead = chunk->next;
+        freeChunk(chunk);
+    }
+    m_heldTail = nullptr;
 }
 
-SendQueue::iterator SendQueue::begin()
-{
-    return m_queue.begin();
+void SendQueue::releaseHeld(uint32_t completed) {
+    //seq 32 bit dor mizane
+    while (m_heldHead && (int32_t)(m_heldHead->seq - completed) < 0) {
+        Chunk* chunk = m_heldHead;
+        m_heldHead = chunk->next;
+        freeChunk(chunk);
+    }
+    if (!m_heldHead)
+        m_heldTail = nullptr;
 }
 
-SendQueue::iterator SendQueue::end()
-{
-    return m_queue.end();
+bool SendQueue::hasHeld() const {
+    return m_heldHead != nullptr;
 }
 
-SendQueue::Buffer &SendQueue::front() {
-    //printf("SendQueue::front(): [%zu]\n", m_queue.size());
-    return m_queue.front();
+size_t SendQueue::size() const {
+    return m_len;
 }
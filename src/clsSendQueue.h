@@ -2,36 +2,60 @@
 #define CLSSENDQUEUE_H
 
 #include "clsBufferPool.h"
+#include "constants.h"
 #include <cstring>
-#include <deque>
+#include <cstdint>
+#include <string>
+#include <sys/uio.h>
 
+// queue e chunk haye SEND_CHUNK_SIZE: write haye koochik (header e yamux, ...) too fazaye khali e
+// chunk e akhar append mishan, ersal faghat offset ro jolo mibare (memmove va allocate e har write nadarim)
 class SendQueue {
 public:
-
-    struct Buffer {
-        void* data;
-        size_t len;
-        //size_t offset = 0;
-    };
-
-    using iterator = std::deque<Buffer>::iterator;
-
     SendQueue(BufferPool& pool);
     ~SendQueue();
     void push(const void* data, size_t len);
+    // data dakhele slab e refcount shode (BufferPool::allocateShared), copy nemishe: slab retain
+    // va ta ersal e in byte ha negah dashte mishe. slab bayad male hamin pool bashe
+    void pushShared(void* slab, const void* data, size_t len);
     bool empty() const;
-    Buffer& front();
-    void pop_front();
+    // iovec ha az aval e queue, ta maxIov ya maxBytes (chunk e avval hamishe), bytes = jame e len ha
+    size_t fillIov(struct iovec* iov, size_t maxIov, size_t maxBytes, size_t& bytes) const;
+    void copyTo(std::string& out) const;
+    // len byte ersal shod. zeroCopy: kernel hanooz az chunk mikhoone, ta completion e seq azad nemishe
+    void consume(size_t len, bool zeroCopy = false, uint32_t seq = 0);
     void clear();
+    // hame seq haye ghabl az completed tamoom shodan
+    void releaseHeld(uint32_t completed);
+    bool hasHeld() const;
     size_t size() const;
-    size_t count() const;
-    iterator begin();
-    iterator end();
 
 
 private:
+    // header dakhele khode block e pool, data bad azash (ya too slab e shared)
+    struct Chunk {
+        Chunk* next;
+        char* base;             // this + 1, ya data e pushShared
+        void* slab;             // pushShared: reference, append nemishe
+        uint32_t begin;         // avalin byte e ersal nashode
+        uint32_t end;           // payan e data, append az inja
+        uint32_t seq;           // MSG_ZEROCOPY, vaghti held hast
+        bool pinned;            // MSG_ZEROCOPY ghesmati ersal shode, kernel hanooz mikhoone
+    };
+
+    static constexpr uint32_t CHUNK_CAPACITY = SEND_CHUNK_SIZE - sizeof(Chunk);
+
+    Chunk* newChunk();
+    void link(Chunk* chunk);
+    void popFront(bool hold, uint32_t seq);
+    void freeChunk(Chunk* chunk);
+
     BufferPool& m_pool;
-    std::deque<Buffer> m_queue;
+    Chunk* m_head;
+    Chunk* m_tail;
+    Chunk* m_heldHead;          // be tartib e seq
+    Chunk* m_heldTail;
+    Chunk* m_spare;             // chunk e khali baraye tail e badi, faghat ta vaghti queue khali nashode
     size_t m_len;
 };
 
@@ -1,24 +1,215 @@
 #include "clsServer.h"
+#include "clsHandoff.h"
+#include <algorithm>
+#include <future>
+#include <map>
+#include <memory>
+#include <set>
+#include <poll.h>
+#include <sched.h>
 
-Server::Server(int maxConnection, int shards): m_shardCount(shards), m_needToStop(false)
+// NUMA topology az sysfs (bedoone libnuma)
+static int numaNodeCount()
+{
+    int count = 0;
+    char path[64];
+    while (true) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", count);
+        if (access(path, F_OK) != 0)
+            break;
+        count++;
+    }
+
+    return count;
+}
+
+static int numaNodeOfCpu(int cpu)
+{
+    char path[96];
+    for (int node = 0; node < numaNodeCount(); ++node) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0)
+            return node;
+    }
+
+    return -1;
+}
+
+// cpulist mesle "0-3,8-11"
+static bool numaNodeCpus(int node, cpu_set_t *pSet)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+
+    CPU_ZERO(pSet);
+    int first, last;
+    char sep;
+    while (fscanf(f, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(f, "%c", &sep) == 1 && sep == '-') {
+            if (fscanf(f, "%d", &last) != 1)
+                break;
+            if (fscanf(f, "%c", &sep) != 1)
+                sep = 0;
+        }
+
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, pSet);
+
+        if (sep != ',')
+            break;
+    }
+
+    fclose(f);
+    return CPU_COUNT(pSet) > 0;
+}
+
+// port e listener (dual-stack, AF_INET6), -1 = error
+static int listenerPort(int fd)
+{
+    sockaddr_in6 addr {};
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (sockaddr*)&addr, &len) < 0)
+        return -1;
+    return ntohs(addr.sin6_port);
+}
+
+// cpu haye mojaz baraye in process (cpuset/taskset, cpu haye offline nistan)
+static std::vector<int> allowedCpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+
+    if (cpus.empty()) {
+        for (int cpu = 0; cpu < (int)std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+Server::Server(int maxConnection, int shards, ReactorBackend backend): m_shardCount(shards), m_needToStop(false)
 {
     for(int i = 0; i < m_shardCount; ++i)
-        m_workerList.emplace_back(std::make_unique<EpollReactor> (i, maxConnection));
+        m_workerList.emplace_back(std::make_unique<EpollReactor> (i, maxConnection, MAX_EVENTS, backend));
 }
 
 Server::~Server() {
     stop();
 }
 
+void Server::setAcceptMode(AcceptMode mode)
+{
+    m_acceptMode = mode;
+}
+
+void Server::setShardPolicy(ShardPolicy policy)
+{
+    m_shardPolicy = policy;
+}
+
+void Server::setFastOpen(int queueLen)
+{
+    m_fastOpenQueue = queueLen;
+}
+
+void Server::setCpuAffinity(bool enable)
+{
+    m_cpuAffinity = enable;
+
+    std::vector<int> cpus = allowedCpus();
+    for (int i = 0; i < m_shardCount; ++i)
+        m_workerList[i]->setCpu(enable ? cpus[i % cpus.size()] : -1);
+}
+
+void Server::setNumaPlacement(bool enable)
+{
+    if (!enable)
+        return;
+
+    int nodes = numaNodeCount();
+    if (nodes <= 0) {
+        printf("NUMA: topology not available\n");
+        return;
+    }
+
+    for (int i = 0; i < m_shardCount; ++i) {
+        EpollReactor *pShard = m_workerList[i].get();
+
+        // pin shode: node e hamoon cpu, vagarna round-robin rooye node ha
+        int node = pShard->cpu() >= 0 ? numaNodeOfCpu(pShard->cpu()) : i % nodes;
+        if (node < 0)
+            node = 0;
+
+        if (!pShard->setNumaNode(node))
+            printf("shard[%d]: can not bind BufferPool to node %d\n", i, node);
+    }
+}
+
+void Server::setBusyPoll(int budget_us, bool socketBusyPoll)
+{
+    for (auto &worker : m_workerList)
+        worker->setBusyPoll(budget_us, socketBusyPoll);
+}
+
+void Server::setIdleTimeout(int secs)
+{
+    for (auto &worker : m_workerList)
+        worker->setIdleTimeout(secs);
+}
+
+void Server::printPlacement()
+{
+    for (int i = 0; i < m_shardCount; ++i) {
+        EpollReactor *pShard = m_workerList[i].get();
+        printf("shard[%d]: cpu=%d node=%d pool_node=%d\n", i, pShard->cpu(), pShard->numaNode(), pShard->bufferPool()->residentNode());
+    }
+}
+
 bool Server::AddNewListener(int Port, const char *bindIP)
 {
     /**/
     if(!bindIP)
         bindIP = "0.0.0.0";
 
-    for (auto& worker : m_workerList) {
+    if (m_acceptMode == ACCEPT_LEAST_LOADED) {
+        int listen_fd = EpollReactor::createListenSocket(Port, m_fastOpenQueue);
+        if (listen_fd < 0)
+            return false;
+
+        if (!addAcceptorListener(listen_fd, Port)) {
+            ::close(listen_fd);
+            return false;
+        }
+        printf("StartListen: (%s:%d) least-loaded\n", bindIP, Port);
+        return true;
+    }
+
+    // steering ba jadval e cpu -> shard, faghat vaghti har shard cpu e khodesh ro dare
+    // (do shard rooye yek cpu: yeki hich connection e steer shode nemigire)
+    std::vector<int> steerCpus;
+    if (m_cpuAffinity && m_shardCount > 1) {
+        for (int i = 0; i < m_shardCount; ++i)
+            steerCpus.push_back(m_workerList[i]->cpu());
+
+        std::vector<int> sorted = steerCpus;
+        std::sort(sorted.begin(), sorted.end());
+        if (sorted.front() < 0 || std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+            steerCpus.clear();
+    }
+
+    for (int i = 0; i < m_shardCount; ++i) {
 
-        if(!worker->add_listener(Port)){
+        if(!m_workerList[i]->add_listener(Port, i == 0 ? steerCpus : std::vector<int>(), m_fastOpenQueue)){
             return false;
         }
     }
@@ -42,17 +233,52 @@ bool Server::start()
 
     for(int i = 0; i < m_shardCount; ++i) {
         m_threads.emplace_back([this, i]() {
+            int cpu = m_workerList[i]->cpu();
+            int node = m_workerList[i]->numaNode();
+            cpu_set_t set;
+            if (cpu >= 0) {
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                if (err != 0)
+                    printf("shard[%d]: can not pin to cpu %d: %s\n", i, cpu, strerror(err));
+            } else if (node >= 0 && numaNodeCpus(node, &set)) {
+                // pin nashode, faghat rooye cpu haye hamoon node
+                int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                if (err != 0)
+                    printf("shard[%d]: can not bind to node %d: %s\n", i, node, strerror(err));
+            }
+
             m_workerList[i]->run(m_needToStop);
         });
     }
 
+    if (m_acceptMode == ACCEPT_LEAST_LOADED && !m_acceptorListeners.empty()) {
+        m_acceptorWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_acceptorWakeFd == -1) {
+            perror("eventfd(acceptor)");
+            return false;
+        }
+
+        m_acceptorStop = false;
+        m_thread = std::thread([this]() {
+            runAcceptor();
+        });
+    }
+
     return true;
 }
 
 void Server::stop() {
 
-    for (auto& worker : m_workerList) {
-        worker->stop_listener();
+    //listener ha male thread e shard hastan (io_uring SQ ba SINGLE_ISSUER), shard e dar hal e ejra ba post
+    //(shutdown_all() ghabl az exit ham mibande), start nashode ya join shode mostaghim
+    for (int i = 0; i < m_shardCount; ++i) {
+        EpollReactor *pShard = m_workerList[i].get();
+        if (i < (int)m_threads.size() && m_threads[i].joinable())
+            pShard->post([pShard] { pShard->stop_listener(); });
+        else
+            pShard->stop_listener();
     }
 
     bool exp = false;
@@ -62,7 +288,7 @@ void Server::stop() {
     for (auto& reactor: m_workerList)
         reactor->wake();
 
-    if (m_thread.joinable()) m_thread.join();
+    stopAcceptor();
 
     for (auto& t : m_threads) {
         if (t.joinable() && t.get_id() != std::this_thread::get_id()) {
@@ -77,6 +303,293 @@ void Server::setUseGarbageCollector(bool value)
         worker->setUseGarbageCollector(value);
 }
 
+EpollReactor* Server::getLeastLoadedShard()
+{
+    if (m_shardCount == 0) {
+        throw std::runtime_error("No shards available");
+    }
+
+    EpollReactor *pBest = m_workerList[0].get();
+    uint32_t bestLoad = pBest->load();
+    for (int i = 1; i < m_shardCount; ++i) {
+        uint32_t load = m_workerList[i]->load();
+        if (load < bestLoad) {
+            bestLoad = load;
+            pBest = m_workerList[i].get();
+        }
+    }
+
+    return pBest;
+}
+
+void Server::runAcceptor()
+{
+    // akharin entry wakeup fd baraye stop()
+    std::vector<pollfd> pfds;
+    for (int fd : m_acceptorListeners)
+        pfds.push_back({fd, POLLIN, 0});
+    pfds.push_back({m_acceptorWakeFd, POLLIN, 0});
+
+    while (!m_needToStop.load(std::memory_order_relaxed) && !m_acceptorStop.load(std::memory_order_relaxed))
+    {
+        int n = poll(pfds.data(), pfds.size(), -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            perror("poll(acceptor)");
+            break;
+        }
+
+        for (size_t i = 0; i + 1 < pfds.size(); ++i) {
+            if (!(pfds[i].revents & POLLIN))
+                continue;
+
+            while (true) {
+                int fd = ::accept4(pfds[i].fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd == -1) {
+                    if (errno == EINTR)
+                        continue;
+
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        perror("accept4(acceptor)");
+                    break;
+                }
+
+                getLeastLoadedShard()->handoffAccepted(fd);
+            }
+        }
+    }
+}
+
+void Server::stopAcceptor()
+{
+    m_acceptorStop = true;
+    if (m_acceptorWakeFd != -1) {
+        uint64_t one = 1;
+        write(m_acceptorWakeFd, &one, sizeof one);
+    }
+
+    if (m_thread.joinable()) m_thread.join();
+    closeAcceptor();
+}
+
+void Server::closeAcceptor()
+{
+    for (int fd : m_acceptorListeners)
+        ::close(fd);
+    m_acceptorListeners.clear();
+
+    if (m_acceptorWakeFd != -1) {
+        ::close(m_acceptorWakeFd);
+        m_acceptorWakeFd = -1;
+    }
+}
+
+bool Server::addAcceptorListener(int listen_fd, int port)
+{
+    for (int fd : m_acceptorListeners) {
+        if (listenerPort(fd) == port)
+            return false;
+    }
+
+    m_acceptorListeners.push_back(listen_fd);
+    return true;
+}
+
+bool Server::adoptHandoff(const char *unixPath)
+{
+    int sock = Handoff::listenAndAccept(unixPath);
+    if (sock < 0)
+        return false;
+
+    // port -> tedad listener e har shard, shard bedoone listener badan add_listener mikone
+    std::map<int, std::vector<int>> listenersPerShard;
+    std::set<int> adoptedPorts;
+    int listenerIndex = 0;
+    int adoptedConnections = 0;
+    bool done = false;
+
+    Handoff::HandoffMsg msg;
+    int fd;
+    while (!done && Handoff::recvFd(sock, &msg, &fd)) {
+        switch (msg.kind) {
+        case Handoff::LISTENER: {
+            if (fd < 0)
+                break;
+
+            if (m_acceptMode == ACCEPT_LEAST_LOADED) {
+                //hame port ha yek listener kafie, baghie (reuseport e process e ghadimi) baste mishan
+                if (TCPSocket::setSocketNonblocking(fd) == -1 || !addAcceptorListener(fd, msg.port)) {
+                    ::close(fd);
+                    break;
+                }
+                adoptedPorts.insert(msg.port);
+                printf("StartListen: (handoff:%d) least-loaded\n", msg.port);
+                break;
+            }
+
+            int shard = listenerIndex++ % m_shardCount;
+            auto &counts = listenersPerShard[msg.port];
+            counts.resize(m_shardCount, 0);
+            if (m_workerList[shard]->adoptListener(fd)) {
+                counts[shard]++;
+                adoptedPorts.insert(msg.port);
+            } else {
+                ::close(fd);
+            }
+            break;
+        }
+        case Handoff::CONNECTION:
+            if (fd < 0)
+                break;
+
+            getLeastLoadedShard()->handoffAccepted(fd);
+            adoptedConnections++;
+            break;
+        case Handoff::DONE:
+            done = true;
+            break;
+        default:
+            if (fd >= 0)
+                ::close(fd);
+            break;
+        }
+    }
+    ::close(sock);
+
+    if (!done) {
+        printf("handoff: old process disconnected before DONE\n");
+        return false;
+    }
+
+    // process e ghadimi shard e kamtar dasht, baghie be reuseport group join mishan
+    if (m_acceptMode == ACCEPT_REUSEPORT) {
+        for (auto &kv : listenersPerShard) {
+            for (int i = 0; i < m_shardCount; ++i) {
+                if (kv.second[i] == 0)
+                    m_workerList[i]->add_listener(kv.first, {}, m_fastOpenQueue);
+            }
+        }
+    }
+
+    printf("handoff: adopted %zu ports, %d connections\n", adoptedPorts.size(), adoptedConnections);
+    return true;
+}
+
+bool Server::handoffTo(const char *unixPath, bool includeIdleConnections)
+{
+    //connection ha dar thread e shard ersal mishan, shard e start nashode ya stop shode post ro ejra nemikone
+    if (m_needToStop || (int)m_threads.size() != m_shardCount) {
+        printf("handoff: shards are not running\n");
+        return false;
+    }
+    for (auto &t : m_threads) {
+        if (!t.joinable()) {
+            printf("handoff: shards are not running\n");
+            return false;
+        }
+    }
+
+    int sock = Handoff::connectTo(unixPath);
+    if (sock < 0)
+        return false;
+
+    if (!m_acceptorListeners.empty()) {
+        // acceptor thread bayad ghabl az ersal e listener ha vaiste
+        std::vector<int> listeners;
+        listeners.swap(m_acceptorListeners);
+        stopAcceptor();
+
+        for (int fd : listeners) {
+            Handoff::sendFd(sock, Handoff::LISTENER, listenerPort(fd), fd);
+            ::close(fd);
+        }
+    }
+
+    // har shard dar thread e khodesh, be tartib ta SEQPACKET ha ghati nashan.
+    // sock male akharin task e: timeout bekhore, task e shard hanooz mitoone azash estefade kone
+    std::shared_ptr<int> pSock(new int(sock), [](int *p) { ::close(*p); delete p; });
+    for (auto &worker : m_workerList) {
+        EpollReactor *pShard = worker.get();
+        auto finished = std::make_shared<std::promise<void>>();
+        std::future<void> result = finished->get_future();
+        pShard->post([pShard, pSock, includeIdleConnections, finished] {
+            pShard->handoff(*pSock, includeIdleConnections);
+            finished->set_value();
+        });
+        if (result.wait_for(std::chrono::milliseconds(HANDOFF_SHARD_TIMEOUT_MS)) != std::future_status::ready) {
+            //bedoone DONE, process e jadid takeover ro fail mikone
+            printf("handoff: shard did not finish in %d ms\n", HANDOFF_SHARD_TIMEOUT_MS);
+            return false;
+        }
+    }
+
+    return Handoff::sendDone(*pSock);
+}
+
+const ShardTelemetry *Server::telemetry(int shard) const
+{
+    if (shard < 0 || shard >= m_shardCount)
+        return nullptr;
+
+    return m_workerList[shard]->telemetry();
+}
+
+void Server::printTelemetry() const
+{
+    for (int i = 0; i < m_shardCount; ++i)
+        m_workerList[i]->telemetry()->print(i);
+}
+
+uint32_t Server::connections() const
+{
+    uint32_t total = 0;
+    for (auto &worker : m_workerList)
+        total += worker->connections();
+    return total;
+}
+
+void Server::rebalance()
+{
+    if (m_shardCount < 2 || (int)m_threads.size() != m_shardCount)
+        return;
+
+    //har shard yek bar khoonde mishe, beyne do khoondan avaz mishe
+    int busy = 0, idle = 0;
+    std::vector<uint32_t> counts(m_shardCount);
+    for (int i = 0; i < m_shardCount; ++i) {
+        counts[i] = m_workerList[i]->connections();
+        if (counts[i] > counts[busy])
+            busy = i;
+        if (counts[i] < counts[idle])
+            idle = i;
+    }
+
+    //har relay do connection, nesf e ekhtelaf jabeja mishe
+    uint32_t relays = (counts[busy] - counts[idle]) / 4;
+    if (relays == 0)
+        return;
+
+    EpollReactor *pBusy = m_workerList[busy].get();
+    EpollReactor *pIdle = m_workerList[idle].get();
+    pBusy->post([pBusy, pIdle, relays] {
+        uint32_t moved = pBusy->rebalanceTo(pIdle, relays);
+        printf("rebalance: %u of %u relays moved\n", moved, relays);
+    });
+}
+
+void Server::drain(int timeout_sec)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout_sec);
+    uint32_t remaining;
+    while ((remaining = connections()) > 0 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    printf("drain: %u connections left\n", remaining);
+    stop();
+}
+
 EpollReactor* Server::getRoundRobinShard()
 {
     if (m_shardCount == 0) {
@@ -87,6 +600,59 @@ EpollReactor* Server::getRoundRobinShard()
     return m_workerList[idx].get();
 }
 
+EpollReactor* Server::getShard()
+{
+    EpollReactor *pShard;
+    switch (m_shardPolicy) {
+    case SHARD_LEAST_CONNECTIONS:
+        pShard = getLeastLoadedShard();
+        break;
+    case SHARD_P2C_CONNECTIONS:
+        pShard = getPowerOfTwoShard(false);
+        break;
+    case SHARD_P2C_QUEUED_BYTES:
+        pShard = getPowerOfTwoShard(true);
+        break;
+    default:
+        return getRoundRobinShard();
+    }
+
+    //ta publish e badi e shard, burst hamash be yek shard nare
+    pShard->notePicked();
+    return pShard;
+}
+
+EpollReactor* Server::getPowerOfTwoShard(bool byQueuedBytes)
+{
+    if (m_shardCount == 0) {
+        throw std::runtime_error("No shards available");
+    }
+    if (m_shardCount == 1)
+        return m_workerList[0].get();
+
+    //xorshift har thread, bedoone lock
+    thread_local uint32_t seed = (uint32_t)std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    int a = (int)(seed % (uint32_t)m_shardCount);
+    int b = (int)((seed >> 16) % (uint32_t)(m_shardCount - 1));
+    if (b >= a)
+        b++;
+
+    EpollReactor *pA = m_workerList[a].get();
+    EpollReactor *pB = m_workerList[b].get();
+    if (byQueuedBytes) {
+        uint64_t qA = pA->queuedBytes();
+        uint64_t qB = pB->queuedBytes();
+        if (qA != qB)
+            return qA < qB ? pA : pB;
+    }
+
+    return pA->load() <= pB->load() ? pA : pB;
+}
+
 
 void Server::setup_signals() {
     sigset_t mask;
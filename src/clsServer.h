@@ -6,13 +6,57 @@
 #include <thread>
 #include <vector>
 
+// tozi e connection ha beyne shard ha
+enum AcceptMode {
+    ACCEPT_REUSEPORT = 0,       // har shard listener khodesh, kernel hash mikone
+    ACCEPT_LEAST_LOADED = 1     // yek acceptor thread, fd be shard ba kamtarin load mire
+};
+
+// entekhab e shard baraye connection haye khoroji (getShard)
+enum ShardPolicy {
+    SHARD_ROUND_ROBIN = 0,
+    SHARD_LEAST_CONNECTIONS = 1,    // kamtarin load() beyne hame shard ha
+    SHARD_P2C_CONNECTIONS = 2,      // power-of-two-choices rooye load()
+    SHARD_P2C_QUEUED_BYTES = 3      // power-of-two-choices rooye queuedBytes()
+};
+
 class Server
 {
 public:
-    explicit Server(int maxConnection, int shards = std::max(1u, std::thread::hardware_concurrency()));
+    explicit Server(int maxConnection, int shards = std::max(1u, std::thread::hardware_concurrency()), ReactorBackend backend = BACKEND_EPOLL);
     ~Server();
 
     void setOnAccepted(EpollReactor::acceptCallback f, void *p);
+    // ghabl az AddNewListener
+    void setAcceptMode(AcceptMode mode);
+    // shard i rooye cpu i az cpu haye mojaz (sched_getaffinity) pin mishe, reuseport listener ha ba jadval e cpu -> shard steer mishan
+    // ghabl az AddNewListener
+    void setCpuAffinity(bool enable);
+    // shard ha rooye NUMA node ha pakhsh mishan va BufferPool har shard local + prefault mishe
+    // bad az setCpuAffinity (agar pin shode, node e hamoon cpu)
+    void setNumaPlacement(bool enable);
+    void printPlacement();
+    void setBusyPoll(int budget_us, bool socketBusyPoll = false);
+    // socket haye bedoone traffic bad az secs baste mishan, 0 = khamoosh
+    void setIdleTimeout(int secs);
+    void setShardPolicy(ShardPolicy policy);
+    // TCP Fast Open rooye listener ha (queueLen SYN e data dar), 0 = khamoosh. ghabl az AddNewListener
+    void setFastOpen(int queueLen);
+
+    // hot upgrade
+    // process e jadid: be jaye AddNewListener, ghabl az start (setOnAccepted ghablesh)
+    bool adoptHandoff(const char *unixPath = HANDOFF_SOCKET_PATH);
+    // process e ghadimi: listener ha (va connection haye idle) ro be process e jadid mide
+    bool handoffTo(const char *unixPath = HANDOFF_SOCKET_PATH, bool includeIdleConnections = false);
+    // ta baste shodane connection haye baghi mande (ya timeout) montazer mimoone, bad stop()
+    void drain(int timeout_sec = DRAIN_TIMEOUT_SECS);
+    uint32_t connections() const;
+    // relay ha (TCPSocket::setRelayPeer) az shard e shologh tarin be khalvat tarin, ta nesf e ekhtelaf (faghat epoll)
+    void rebalance();
+
+    // telemetry, bedoone lock az har thread
+    const ShardTelemetry *telemetry(int shard) const;
+    void printTelemetry() const;
     bool AddNewListener(int Port, const char *bindIP = nullptr);
     bool start();
     void stop();
@@ -20,6 +64,9 @@ public:
 
     void setUseGarbageCollector(bool value);
     EpollReactor *getRoundRobinShard();
+    EpollReactor *getLeastLoadedShard();
+    // bar asas e ShardPolicy, thread safe
+    EpollReactor *getShard();
 
 private:
     int m_shardCount;
@@ -29,7 +76,20 @@ private:
     std::thread m_thread {};
     std::atomic <bool> m_needToStop {};
     std::atomic <uint32_t> m_roundRobin { 0 };
+    AcceptMode m_acceptMode {ACCEPT_REUSEPORT};
+    ShardPolicy m_shardPolicy {SHARD_ROUND_ROBIN};
+    bool m_cpuAffinity {false};
+    int m_fastOpenQueue {0};
+    std::vector <int> m_acceptorListeners {};
+    int m_acceptorWakeFd {-1};
+    std::atomic <bool> m_acceptorStop {false};
     void setup_signals();
+    void runAcceptor();
+    void closeAcceptor();
+    void stopAcceptor();
+    // least-loaded: yek listener baraye har port, false = port tekrari
+    bool addAcceptorListener(int listen_fd, int port);
+    EpollReactor *getPowerOfTwoShard(bool byQueuedBytes);
 
 };
 
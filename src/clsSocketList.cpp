@@ -2,6 +2,7 @@
 #include "clsSocketList.h"
 #include "clsTCPSocket.h"
 #include <cstdio>
+#include <sys/mman.h>
 
 uint32_t SocketList::genIDCounter() const
 {
@@ -13,53 +14,57 @@ uint32_t SocketList::count() const
     return m_activeConnectionList.size();
 }
 
-
-uint32_t SocketList::maximumSize() const
+uint32_t SocketList::count(SockTypes sockType) const
 {
-    /*
-    int ret = 0;
-    for (int i = 0; i < (int)m_list.size(); i++) {
-        if(m_list[i]->fd > 0){
-            ret++;
-        }
-    }
-*/
-
-    return m_list.size();
+    return m_typeCount[sockType];
 }
 
-std::vector<SockInfo *> *SocketList::list()
+
+uint32_t SocketList::maximumSize() const
 {
-    return &m_list;
+    return (uint32_t)m_maxFD;
 }
 
 void SocketList::forEachActive(std::function<void (SockInfo *)> callback) {
     m_activeConnectionList.for_each(callback);
 }
 
-SocketList::SocketList(int MaxFD):m_list(MaxFD, nullptr) {
-
-    //init preallocate
-    for (int i = 0; i < MaxFD; i++) {
-        m_list[i] = new SockInfo;
+SocketList::SocketList(int MaxFD) {
+    //fd bayad too 24 bit e SockInfo::fd ja beshe
+    if (MaxFD > (1 << 23))
+        MaxFD = 1 << 23;
+
+    //bedoone new baraye har slot: faghat address space, kernel page ro ba avalin write (sefr) mide
+    m_tableBytes = (size_t)MaxFD * sizeof(SockInfo);
+    void *p = mmap(nullptr, m_tableBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap(SocketList)");
+        m_tableBytes = 0;
+        return;
     }
+
+    m_table = static_cast<SockInfo*>(p);
+    m_maxFD = MaxFD;
 }
 
 SocketList::~SocketList()
 {
-    for (int i = 0; i < (int)m_list.size(); i++) {
-        delete m_list[i];
-    }
+    if (m_table)
+        munmap(m_table, m_tableBytes);
 }
 
 SockInfo *SocketList::add(int fd, SockTypes sockType, void* ptr) {
-    if (fd <= 0 || fd >= (int)m_list.size()){
+    if (fd <= 0 || fd >= m_maxFD){
         return nullptr;
     }
 
-    SockInfo *pSocketInfo = m_list[fd];
+    SockInfo *pSocketInfo = &m_table[fd];
+    if (pSocketInfo->type != IS_NOT_SET)
+        m_typeCount[pSocketInfo->type]--;
+
     pSocketInfo->fd = fd;
     pSocketInfo->type = sockType;
+    m_typeCount[sockType]++;
     if(ptr)
         pSocketInfo->socketBasePtr = ptr;
 
@@ -79,7 +84,7 @@ SockInfo *SocketList::add(int fd, SockTypes sockType, void* ptr) {
 }
 
 SockInfo *SocketList::get(int fd, uint32_t sockgenId) {
-    if (fd < 0 || fd >= (int)m_list.size())
+    if (fd < 0 || fd >= m_maxFD)
         return nullptr;
 
     //printf("SocketList::get genID: %d sockgenId: %d\n", m_list[fd]->genID, sockgenId);
@@ -88,19 +93,21 @@ SockInfo *SocketList::get(int fd, uint32_t sockgenId) {
         return nullptr;
     }*/
 
-    if(m_list[fd]->genID != sockgenId){
+    //slot e hichvaght estefade nashode: zero page, genID 0
+    SockInfo *pSocketInfo = &m_table[fd];
+    if(pSocketInfo->genID != sockgenId){
         return nullptr;
     }
 
-    return m_list[fd];
+    return pSocketInfo;
 }
 
 void SocketList::remove(int fd) {
-    if (fd < 0 || fd >= (int)m_list.size())
+    if (fd < 0 || fd >= m_maxFD)
         return;
 
-    SockInfo* pSocketInfo = m_list[fd];
-    if (pSocketInfo) {
+    SockInfo* pSocketInfo = &m_table[fd];
+    if (pSocketInfo->type != IS_NOT_SET) {
         //remove from active list
         m_activeConnectionList.remove(pSocketInfo);
 
@@ -116,6 +123,9 @@ void SocketList::remove(int fd) {
             */
         }
 
+        if (pSocketInfo->type != IS_NOT_SET)
+            m_typeCount[pSocketInfo->type]--;
+
         pSocketInfo->genID = ++m_genIDCounter;
         pSocketInfo->type = IS_NOT_SET;
         m_genIDCounter++;
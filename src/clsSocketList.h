@@ -2,7 +2,7 @@
 #define CLSSOCKETLIST_H
 
 #include <cstdint>
-#include <vector>
+#include <functional>
 #include "clsIntrusiveList.h"
 
 
@@ -15,24 +15,32 @@ enum SockTypes {
     IS_UDP_SOCKET = 4,
     IS_TIMER_SOCKET = 5,
     IS_TIMER_MANAGER_SOCKET = 6,
-    IS_DNS_LOOKUP_SOCKET = 7
+    IS_DNS_LOOKUP_SOCKET = 7,
+    IS_WAKEUP_SOCKET = 8,
+    IS_CONNECT_ATTEMPT = 9      // Happy Eyeballs, ptr = HappyEyeballs
 };
 
-struct SockInfo {
-    SockTypes type;
-    void* socketBasePtr {nullptr};
-    int fd{-1};
-    uint32_t genID{0};
+// 32 byte, 2 ta dar har cache line; type/ptr/genID dar 16 byte e aval (dispatch faghat ina ro mikhoone)
+// hame sefr = khali (IS_NOT_SET, genID 0), page haye mmap e SocketList sefr hastan
+struct alignas(32) SockInfo {
+    void* socketBasePtr;
+    uint32_t genID;
+    SockTypes type : 8;
+    int fd : 24;                // mesle user_data e io_uring, fd < 2^23
     IntrusiveLink active_link;
 };
+static_assert(sizeof(SockInfo) == 32, "SockInfo must stay 32 bytes");
 
 class SocketList
 {
 private:
-    std::vector<SockInfo*> m_list;
+    SockInfo *m_table {nullptr};        // MaxFD entry, lazy: page faghat ba avalin fd dar oon range commit mishe
+    size_t m_tableBytes {0};
+    int m_maxFD {0};
     using ActiveSocketList = IntrusiveList<SockInfo, &SockInfo::active_link>;
     ActiveSocketList m_activeConnectionList;
     uint32_t m_genIDCounter{0};
+    uint32_t m_typeCount[IS_CONNECT_ATTEMPT + 1] {};
 
 
 public:
@@ -48,8 +56,8 @@ public:
     void remove(int fd);
     uint32_t genIDCounter() const;
     uint32_t count() const;
+    uint32_t count(SockTypes sockType) const;
     uint32_t maximumSize() const;
-    std::vector<SockInfo*> *list();
     void forEachActive(std::function<void(SockInfo*)> callback);
 };
 
@@ -3,12 +3,22 @@
 #include "clsSocketList.h"
 #include "epoll.h"
 #include "clsDNSLookup.h"
+#include "clsHappyEyeballs.h"
+#include <linux/filter.h>
+#include <sys/ioctl.h>
+#include <linux/errqueue.h>
 
 TCPSocket::TCPSocket()
 {
 
 }
 
+TCPSocket::~TCPSocket()
+{
+    //hanooz dar hale connect
+    delete m_pEyeballs;
+}
+
 TCPSocket::socketStatus TCPSocket::getStatus() const
 {
     return status;
@@ -116,18 +126,216 @@ void TCPSocket::setSocketLowDelay(int fd, bool isEnable)
     setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
 }
 
+//for Gaming and VOIP, recv/poll rooye NIC queue spin mikone (bishtar az net.core.busy_poll CAP_NET_ADMIN mikhad)
+void TCPSocket::setSocketBusyPoll(int fd, int usec)
+{
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0)
+        perror("setsockopt(SO_BUSY_POLL)");
+
+    int prefer = usec > 0;
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+}
+
+//SYN ba data bedoone 3-way handshake (cookie e client ghablan gerefte shode)
+void TCPSocket::setSocketFastOpen(int fd, int queueLen)
+{
+    if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &queueLen, sizeof(queueLen)) < 0)
+        perror("setsockopt(TCP_FASTOPEN)");
+}
+
+//net.ipv4.tcp_fastopen bit e client nadashte bashe EOPNOTSUPP, connect e mamooli
+bool TCPSocket::setSocketFastOpenConnect(int fd, bool isEnable)
+{
+    int optval = isEnable ? 1 : 0;
+    return setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &optval, sizeof(optval)) == 0;
+}
+
+//reuseport group ke socket ha ba hamoon cpu tarjih dade beshan
+void TCPSocket::setSocketIncomingCpu(int fd, int cpu)
+{
+    if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0)
+        perror("setsockopt(SO_INCOMING_CPU)");
+}
+
+//connection e jadid be socket i ke rooye cpu e softirq pin shode (shardCpus[i] == cpu)
+//cpu bedoone shard: index e kharej az group, kernel ba hash entekhab mikone
+//#mohem: tartib e listen dar group = tartib e shard ha
+bool TCPSocket::attachCpuSteering(int fd, const std::vector<int> &shardCpus)
+{
+    std::vector<sock_filter> code;
+    code.push_back({ BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) });
+    for (size_t i = 0; i < shardCpus.size(); i++) {
+        code.push_back({ BPF_JMP | BPF_JEQ | BPF_K, 0, 1, (uint32_t)shardCpus[i] });
+        code.push_back({ BPF_RET | BPF_K, 0, 0, (uint32_t)i });
+    }
+    code.push_back({ BPF_RET | BPF_K, 0, 0, 0xFFFFFFFF });
+
+    sock_fprog prog {};
+    prog.len = (unsigned short)code.size();
+    prog.filter = code.data();
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        perror("setsockopt(SO_ATTACH_REUSEPORT_CBPF)");
+        return false;
+    }
+
+    return true;
+}
 
 SocketContext *TCPSocket::getSocketContext()
 {
     return &m_SocketContext;
 }
 
-void TCPSocket::handleOnData(const uint8_t *d, size_t n) {
+size_t TCPSocket::handleOnData(const uint8_t *d, size_t n) {
+    size_t consumed;
     if(m_onData){
-        m_onData(m_callbacksArg, d, n);
+        consumed = m_onData(m_callbacksArg, d, n);
     }else{
-        onReceiveData(d, n);
+        consumed = onReceiveData(d, n);
+    }
+    return std::min(consumed, n);
+}
+
+// rBuffer ro (2x ta RECV_BUFFER_MAX) bozorg mikone, false = frame az had bozorg tar ya budget e shard tamoom
+// (frame haye naghes e ziad nabayad shard ro az RECV_BUFFER_BUDGET rad konan, caller close mikone)
+bool TCPSocket::reserveReadBuffer(size_t needed)
+{
+    if (needed <= m_SocketContext.rBufferCapacity)
+        return true;
+    if (needed > RECV_BUFFER_MAX)
+        return false;
+
+    size_t current = std::max(m_SocketContext.rBufferCapacity, RECV_BUFFER_MIN);
+    size_t capacity = current;
+    while (capacity < needed)
+        capacity *= 2;
+    capacity = std::min(capacity, RECV_BUFFER_MAX);
+
+    //mesle noteRecvBuffer: faghat bishtar az RECV_BUFFER_MIN
+    if (m_pReactor->recvBufferBytes() + (capacity - current) > RECV_BUFFER_BUDGET) {
+        printf("receive buffer budget exhausted fd=%d need=%zu\n", m_SocketContext.fd, needed);
+        return false;
+    }
+
+    return resizeReadBuffer(capacity);
+}
+
+// compact: tail e masraf nashode be aval e rBuffer miad
+void TCPSocket::consumeReadBuffer(size_t consumed)
+{
+    //too callback close shode
+    if (!m_SocketContext.rBuffer)
+        return;
+
+    //sendFrom: slab too SendQueue e peer e, recv e badi nabayad rooye oon byte ha benevise
+    BufferPool *pool = m_pReactor->bufferPool();
+    if (pool->refCount(m_SocketContext.rBuffer) > 1) {
+        size_t rest = consumed >= m_SocketContext.rBufferLength ? 0 : m_SocketContext.rBufferLength - consumed;
+        char *buffer = (char*)pool->allocateShared(m_SocketContext.rBufferCapacity);
+        if (!buffer) {
+            perror("Error allocate failed: ");
+            close(true);
+            return;
+        }
+        memcpy(buffer, m_SocketContext.rBuffer + consumed, rest);
+        pool->release(m_SocketContext.rBuffer);
+        m_SocketContext.rBuffer = buffer;
+        m_SocketContext.rBufferLength = rest;
+        return;
+    }
+
+    if (consumed >= m_SocketContext.rBufferLength) {
+        m_SocketContext.rBufferLength = 0;
+        return;
     }
+
+    if (consumed) {
+        m_SocketContext.rBufferLength -= consumed;
+        memmove(m_SocketContext.rBuffer, m_SocketContext.rBuffer + consumed, m_SocketContext.rBufferLength);
+    }
+}
+
+// rBuffer ro be capacity mibare (bozorg ya koochik), budget e shard ham inja hesab mishe
+bool TCPSocket::resizeReadBuffer(size_t capacity)
+{
+    BufferPool *pool = m_pReactor->bufferPool();
+    char *buffer;
+    if (m_SocketContext.rBufferLength == 0) {
+        //khali: realloc bi mored copy mikone
+        buffer = (char*)pool->allocateShared(capacity);
+        if (buffer)
+            pool->release(m_SocketContext.rBuffer);
+    } else if (pool->refCount(m_SocketContext.rBuffer) > 1) {
+        //slab hanooz too SendQueue e peer e
+        buffer = (char*)pool->allocateShared(capacity);
+        if (buffer) {
+            memcpy(buffer, m_SocketContext.rBuffer, m_SocketContext.rBufferLength);
+            pool->release(m_SocketContext.rBuffer);
+        }
+    } else {
+        buffer = (char*)pool->reallocateShared(m_SocketContext.rBuffer, capacity);
+    }
+
+    if (!buffer)
+        return false;
+
+    m_pReactor->noteRecvBuffer(m_SocketContext.rBufferCapacity, capacity);
+    m_SocketContext.rBuffer = buffer;
+    m_SocketContext.rBufferCapacity = capacity;
+
+    //buffer e bozorg, vaghti flow idle shod koochik mishe
+    if (capacity > RECV_BUFFER_MIN && !m_rBufferTimer.isActive())
+        m_pReactor->timers()->start(&m_rBufferTimer, RECV_BUFFER_IDLE_MS, onReadBufferIdle, this, true);
+    return true;
+}
+
+void TCPSocket::releaseReadBuffer()
+{
+    if (!m_SocketContext.rBuffer)
+        return;
+
+    m_pReactor->noteRecvBuffer(m_SocketContext.rBufferCapacity, 0);
+    m_pReactor->bufferPool()->release(m_SocketContext.rBuffer);
+    m_SocketContext.rBuffer = nullptr;
+    m_SocketContext.rBufferCapacity = 0;
+    m_SocketContext.rBufferLength = 0;
+}
+
+// recv poshte sar ham kole buffer ro por karde (flow e bulk): 2x, dar had e budget e shard
+void TCPSocket::growReadBuffer()
+{
+    if (++m_fullReads < RECV_BUFFER_GROW_STREAK)
+        return;
+    m_fullReads = 0;
+
+    size_t capacity = m_SocketContext.rBufferCapacity;
+    if (capacity >= RECV_BUFFER_MAX)
+        return;
+
+    size_t newCapacity = std::min(capacity * 2, RECV_BUFFER_MAX);
+    if (m_pReactor->recvBufferBytes() + (newCapacity - capacity) > RECV_BUFFER_BUDGET)
+        return;
+
+    resizeReadBuffer(newCapacity);
+}
+
+void TCPSocket::onReadBufferIdle(void *p)
+{
+    TCPSocket *pSocket = static_cast<TCPSocket*>(p);
+    SocketContext &ctx = pSocket->m_SocketContext;
+    if (pSocket->getStatus() != Connected || ctx.rBufferCapacity <= RECV_BUFFER_MIN)
+        return;
+
+    //frame e naghes dare ya flow hanooz faal e
+    uint64_t elapsed = pSocket->m_pReactor->getCachedNow() - pSocket->getLastActiveTime();
+    if (ctx.rBufferLength || elapsed * 1000 < RECV_BUFFER_IDLE_MS) {
+        pSocket->m_pReactor->timers()->start(&pSocket->m_rBufferTimer, RECV_BUFFER_IDLE_MS, onReadBufferIdle, pSocket, true);
+        return;
+    }
+
+    pSocket->m_fullReads = 0;
+    pSocket->resizeReadBuffer(RECV_BUFFER_MIN);
 }
 
 void TCPSocket::handleOnAccepted()
@@ -139,71 +347,696 @@ void TCPSocket::handleOnAccepted()
     }
 }
 
-void TCPSocket::handleOnClose()
+void TCPSocket::handleOnClose()
+{
+    if(m_onClose){
+        m_onClose(m_callbacksArg);
+    }else{
+        onClose();
+    }
+}
+
+void TCPSocket::handleOnConnectFailed()
+{
+    if(m_onConnectFailed){
+        m_onConnectFailed(m_callbacksArg);
+    }else{
+        onConnectFailed();
+    }
+}
+
+void TCPSocket::handleOnConnecting()
+{
+    if(m_onConnecting){
+
+        m_onConnecting(m_callbacksArg);
+
+    }else{
+        onConnecting();
+    }
+}
+
+void TCPSocket::handleOnConnected()
+{
+    if(m_onConnected){
+        m_onConnected(m_callbacksArg);
+    }else{
+        onConnected();
+    }
+}
+
+void TCPSocket::handleOnPause() {
+    if (m_onPause)
+        m_onPause(m_callbacksArg);
+}
+
+void TCPSocket::handleOnResume() {
+    if (m_onResume)
+        m_onResume(m_callbacksArg);
+}
+
+void TCPSocket::handleOnMigrated()
+{
+    if(m_onMigrated){
+        m_onMigrated(m_callbacksArg);
+    }else{
+        onMigrated();
+    }
+}
+
+void TCPSocket::pause_reading() {
+    if (pauseWhileMigrating(true) || !m_pReactor || m_readPaused)
+        return;  // جلوگیری از تکرار
+    printf("pause_reading(%d)\n", m_readPaused);
+    m_readPaused = true;
+    m_pReactor->telemetry()->pauses.add(1);
+    m_pReactor->removeFlags(&m_SocketContext, EPOLLIN);
+    handleOnPause();  // trigger callback
+}
+
+void TCPSocket::resume_reading() {
+    if (pauseWhileMigrating(false) || !m_pReactor || !m_readPaused)
+        return;
+
+    printf("resume_reading()\n");
+    m_readPaused = false;
+    m_pReactor->telemetry()->resumes.add(1);
+    m_pReactor->addFlags(&m_SocketContext, EPOLLIN);
+    //EPOLLET: pause/resume dar yek dor coalesce mishe va MOD nemiad, data e mounde ro khodemoon mikhoonim
+    //(io_uring na: recv e armed ba recv e mostaghim tartib ro beham mizane)
+    if (m_pReactor->backend() == BACKEND_EPOLL)
+        m_pReactor->scheduleRead(&m_SocketContext);
+    handleOnResume();  // trigger callback
+}
+
+bool TCPSocket::spliceWith(TCPSocket *peer)
+{
+    if (!peer || peer == this || !m_pReactor || m_pReactor != peer->m_pReactor)
+        return false;
+
+    if (getStatus() != Connected || peer->getStatus() != Connected || m_splicePeer || peer->m_splicePeer)
+        return false;
+
+    // io_uring: recv/send e feli (IORING_OP_SPLICE hanooz na)
+    if (m_pReactor->backend() != BACKEND_EPOLL)
+        return false;
+
+    if (!openSplicePipe() || !peer->openSplicePipe()) {
+        stopSplice();
+        peer->stopSplice();
+        return false;
+    }
+
+    //data e masraf nashode too rBuffer ghabl az splice (tartib e byte ha)
+    if (m_SocketContext.rBufferLength) {
+        peer->send(m_SocketContext.rBuffer, m_SocketContext.rBufferLength);
+        m_SocketContext.rBufferLength = 0;
+    }
+    if (peer->m_SocketContext.rBufferLength) {
+        send(peer->m_SocketContext.rBuffer, peer->m_SocketContext.rBufferLength);
+        peer->m_SocketContext.rBufferLength = 0;
+    }
+
+    m_splicePeer = peer;
+    peer->m_splicePeer = this;
+
+    //EPOLLET: data e too kernel edge e jadid nemide
+    m_pReactor->scheduleRead(&m_SocketContext);
+    m_pReactor->scheduleRead(&peer->m_SocketContext);
+    return true;
+}
+
+bool TCPSocket::isSpliced() const
+{
+    return m_splicePeer != nullptr;
+}
+
+bool TCPSocket::hasPendingWrite() const
+{
+    return !m_SocketContext.writeQueue->empty() || m_splicePending != 0 || m_SocketContext.writeQueue->hasHeld();
+}
+
+void TCPSocket::setZeroCopy(bool enable)
+{
+    m_zeroCopy = enable;
+    m_zeroCopyCopied = 0;
+}
+
+void TCPSocket::setAutoCork(bool enable)
+{
+    m_autoCork = enable;
+}
+
+void TCPSocket::flushCorked()
+{
+    //EPOLLOUT armed (EAGAIN ya graceful close): onWritable khodesh ersal mikone
+    if (getStatus() == Closed || !m_SocketContext.writeQueue || m_SocketContext.writeQueue->empty()
+            || (m_SocketContext.ev.events & EPOLLOUT))
+        return;
+
+    //io_uring: sendmsg ba armSend too submit e badi
+    if (m_pReactor->backend() == BACKEND_IO_URING) {
+        m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
+        return;
+    }
+
+    if (!writeQueued())
+        return;
+
+    if (!m_SocketContext.writeQueue->empty())
+        m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
+    finishWrite();
+}
+
+bool TCPSocket::enableZeroCopy()
+{
+    if (m_zeroCopyEnabled)
+        return true;
+
+    int one = 1;
+    if (::setsockopt(m_SocketContext.fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == -1) {
+        perror("setsockopt SO_ZEROCOPY");
+        m_zeroCopy = false;
+        return false;
+    }
+
+    m_zeroCopyEnabled = true;
+    return true;
+}
+
+bool TCPSocket::readErrorQueue()
+{
+    //zerocopy nadashtim, EPOLLERR e vagheyi e
+    if (!m_zeroCopyEnabled)
+        return false;
+
+    bool completed = false;
+    while (true) {
+        char control[128];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (::recvmsg(m_SocketContext.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            sock_extended_err *serr = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cm));
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0)
+                return false;
+
+            onZeroCopyCompleted(serr->ee_info, serr->ee_data, serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+            completed = true;
+        }
+    }
+
+    if (!completed || getErrorCode() != 0)
+        return false;
+
+    //graceful close montazer e completion bood
+    if (m_pendingClose)
+        finishWrite();
+    return true;
+}
+
+// range e [lo, hi] az seq haye sendmsg tamoom shod, block ha az avval e tartib azad mishan
+void TCPSocket::onZeroCopyCompleted(uint32_t lo, uint32_t hi, bool copied)
+{
+    if (copied) {
+        //kernel copy karde (masalan loopback): zerocopy faghat hazine dare
+        if (++m_zeroCopyCopied >= ZEROCOPY_COPIED_LIMIT && m_zeroCopy) {
+            printf("zerocopy fell back to copy, disabled fd=%d\n", m_SocketContext.fd);
+            m_zeroCopy = false;
+        }
+        m_pReactor->telemetry()->zeroCopyCopied.add(hi - lo + 1);
+    } else {
+        m_zeroCopyCopied = 0;
+    }
+
+    if (lo != m_zeroCopyCompleted) {
+        m_zeroCopyRanges.push_back({lo, hi});
+        return;
+    }
+
+    m_zeroCopyCompleted = hi + 1;
+    for (size_t i = 0; i < m_zeroCopyRanges.size(); ) {
+        if (m_zeroCopyRanges[i].first == m_zeroCopyCompleted) {
+            m_zeroCopyCompleted = m_zeroCopyRanges[i].second + 1;
+            m_zeroCopyRanges[i] = m_zeroCopyRanges.back();
+            m_zeroCopyRanges.pop_back();
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    m_SocketContext.writeQueue->releaseHeld(m_zeroCopyCompleted);
+}
+
+bool TCPSocket::openSplicePipe()
+{
+    if (m_splicePipe[0] != -1)
+        return true;
+
+    if (::pipe2(m_splicePipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("pipe2");
+        m_splicePipe[0] = m_splicePipe[1] = -1;
+        return false;
+    }
+
+    //pipe-max-size ya budget e user por bashe, default (64KB) mimoone
+    ::fcntl(m_splicePipe[1], F_SETPIPE_SZ, (int)SPLICE_PIPE_SIZE);
+    m_splicePending = 0;
+    return true;
+}
+
+// close: peer dige too pipe e in socket nemirize, pipe e khodesh ta close e khodesh mimoone
+void TCPSocket::stopSplice()
+{
+    if (m_splicePeer) {
+        m_splicePeer->m_splicePeer = nullptr;
+        m_splicePeer = nullptr;
+    }
+
+    if (m_splicePipe[0] != -1) {
+        ::close(m_splicePipe[0]);
+        ::close(m_splicePipe[1]);
+        m_splicePipe[0] = m_splicePipe[1] = -1;
+    }
+    m_splicePending = 0;
+}
+
+// socket -> pipe e peer -> peer, mesle onReadable ba budget
+void TCPSocket::spliceReadable()
+{
+    TCPSocket *peer = m_splicePeer;
+    size_t budgetBytes = 0;
+    int budgetCalls = 0;
+    while (true)
+    {
+        if (budgetBytes >= READ_BUDGET_BYTES || budgetCalls >= READ_BUDGET_CALLS) {
+            m_pReactor->scheduleRead(&m_SocketContext);
+            break;
+        }
+        budgetCalls++;
+
+        ssize_t n = ::splice(m_SocketContext.fd, nullptr, peer->m_splicePipe[1], nullptr, SPLICE_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            budgetBytes += (size_t)n;
+            m_pReactor->telemetry()->bytesIn.add((uint64_t)n);
+            updateLastActive();
+            peer->m_splicePending += (size_t)n;
+            peer->flushSplice();
+
+            //peer too flush close shod ya pause
+            if (m_readPaused || m_splicePeer != peer || getStatus() == Closed)
+                break;
+            continue;
+        }
+
+        if (n == 0) {
+            handleReadEof();
+            break;
+        }
+
+        if (errno == EINTR)
+            continue;
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            //EAGAIN ham baraye socket e khali ham pipe e por, FIONREAD farghesh ro mige
+            int available = 0;
+            if (peer->m_splicePending && ::ioctl(m_SocketContext.fd, FIONREAD, &available) == 0 && available > 0) {
+                //peer khali beshe resume mikone
+                pause_reading();
+            } else {
+                m_pReactor->telemetry()->recvEagain.add(1);
+            }
+            break;
+        }
+
+        close(true);
+        break;
+    }
+}
+
+// pipe -> socket, faghat bad az writeQueue (tartib e byte ha)
+void TCPSocket::flushSplice()
+{
+    if (!m_SocketContext.writeQueue->empty())
+        return;
+
+    while (m_splicePending) {
+        ssize_t n = ::splice(m_splicePipe[0], nullptr, m_SocketContext.fd, nullptr, m_splicePending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            m_splicePending -= (size_t)n;
+            m_pReactor->telemetry()->bytesOut.add((uint64_t)n);
+            updateLastActive();
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            m_pReactor->telemetry()->sendEagain.add(1);
+            m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
+            return;
+        }
+
+        close(true);
+        return;
+    }
+}
+
+void TCPSocket::detach()
+{
+    m_detached = true;
+    close(true);
+}
+
+void TCPSocket::setHandoffIdle(bool isIdle)
+{
+    m_handoffIdle = isIdle;
+}
+
+bool TCPSocket::isHandoffIdle() const
+{
+    return m_handoffIdle;
+}
+
+bool TCPSocket::canMigrate(EpollReactor *target) const
+{
+    if (!m_pReactor || !target || target == m_pReactor)
+        return false;
+
+    if (getStatus() != Connected || m_pendingClose || m_detached || m_migrateState.load(std::memory_order_relaxed) != MIGRATE_NONE)
+        return false;
+
+    //pipe va peer male in shard hastan, block haye zerocopy ta completion too pool e in shard
+    if (m_splicePeer || m_SocketContext.writeQueue->hasHeld()) {
+        printf("migrate: spliced or zerocopy in flight\n");
+        return false;
+    }
+
+    // io_uring: recv e armed ba provided buffer ghabl az cancel mitoone data begire
+    if (m_pReactor->backend() != BACKEND_EPOLL || target->backend() != BACKEND_EPOLL) {
+        printf("migrate: only supported on epoll backend\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool TCPSocket::migrateTo(EpollReactor *target, TCPSocket *peer)
+{
+    if (!canMigrate(target))
+        return false;
+
+    if (peer && (peer == this || peer->m_pReactor != m_pReactor || !peer->canMigrate(target)))
+        return false;
+
+    //momkene az dakhele onReceiveData seda zade beshe, pas bad az callback ha
+    m_migrateState.store(MIGRATE_SCHEDULED, std::memory_order_relaxed);
+    if (peer)
+        peer->m_migrateState.store(MIGRATE_SCHEDULED, std::memory_order_relaxed);
+    m_pReactor->scheduleMigration(&m_SocketContext, peer ? &peer->m_SocketContext : nullptr, target);
+    return true;
+}
+
+void TCPSocket::setRelayPeer(TCPSocket *peer)
+{
+    m_relayPeer = peer;
+}
+
+TCPSocket *TCPSocket::relayPeer() const
+{
+    return m_relayPeer;
+}
+
+void TCPSocket::_migrate(EpollReactor *target, TCPSocket *peer)
+{
+    MigratedData data;
+    MigratedData peerData;
+    bool moved = detachForMigration(data);
+    bool peerMoved = peer && peer->detachForMigration(peerData);
+    if (!moved && !peerMoved)
+        return;
+
+    //har do dar yek task: ta adopt e dovomi, send e avali be peer too m_migrateSendData e oon jam mishe
+    target->post([this, peer, target, moved, peerMoved, data = std::move(data), peerData = std::move(peerData)] {
+        if (moved)
+            adoptMigrated(target, data);
+        if (peerMoved)
+            peer->adoptMigrated(target, peerData);
+
+        //callback ha bad az adopt e har do
+        if (moved)
+            finishMigration();
+        if (peerMoved)
+            peer->finishMigration();
+    });
+}
+
+bool TCPSocket::detachForMigration(MigratedData &data)
+{
+    if (getStatus() != Connected || m_pendingClose) {
+        m_migrateState.store(MIGRATE_NONE, std::memory_order_relaxed);
+        return false;
+    }
+
+    //az epoll va SocketList e shard e feli kharej mishe, fd baz mimoone
+    //timer ha male wheel e in shard hastan, too shard e jadid dobare arm mishan
+    stopDeadlines();
+    m_pReactor->del_fd(m_SocketContext.fd, true);
+    m_SocketContext.readScheduled = false;
+    m_SocketContext.flushScheduled = false;
+
+    //#mohem: BufferPool (TLSF) har shard thread safe nist, inja copy va azad, too shard e jadid allocate
+    if (m_SocketContext.rBuffer) {
+        data.readData.assign(m_SocketContext.rBuffer, m_SocketContext.rBufferLength);
+        releaseReadBuffer();
+    }
+
+    data.sendData.reserve(m_SocketContext.writeQueue->size());
+    m_SocketContext.writeQueue->copyTo(data.sendData);
+    delete m_SocketContext.writeQueue;
+    m_SocketContext.writeQueue = nullptr;
+
+    //m_pReactor ta adopt hamoon shard e ghadimi mimoone, az in be bad send/close/pause ba m_migrateLock
+    m_migrateState.store(MIGRATE_IN_FLIGHT, std::memory_order_release);
+    return true;
+}
+
+void TCPSocket::adoptMigrated(EpollReactor *target, const MigratedData &data)
+{
+    std::lock_guard<std::mutex> lock(m_migrateLock);
+    m_pReactor = target;
+    m_SocketContext.writeQueue = new SendQueue(*m_pReactor->bufferPool());
+    m_migrateState.store(MIGRATE_NONE, std::memory_order_release);
+
+    //frame e naghes momkene az RECV_BUFFER_MIN bozorg tar bashe
+    if (!resizeReadBuffer(std::max(RECV_BUFFER_MIN, data.readData.size()))) {
+        perror("Error allocate failed: ");
+        m_migrateClose = m_migrateForceClose = true;
+        return;
+    }
+
+    memcpy(m_SocketContext.rBuffer, data.readData.data(), data.readData.size());
+    m_SocketContext.rBufferLength = data.readData.size();
+
+    //push khodesh chunk be chunk mikone, send haye dar jaryan e migrate bad az data e ghabli
+    m_SocketContext.writeQueue->push(data.sendData.data(), data.sendData.size());
+    m_SocketContext.writeQueue->push(m_migrateSendData.data(), m_migrateSendData.size());
+    std::string().swap(m_migrateSendData);
+
+    if (!m_SocketContext.writeQueue->empty())
+        m_SocketContext.ev.events |= EPOLLOUT;
+
+    //EPOLLET: age data too kernel mounde bashe EPOLL_CTL_ADD event mide
+    if (!m_pReactor->register_fd(m_SocketContext.fd, &m_SocketContext.ev, IS_TCP_SOCKET, this))
+        m_migrateClose = m_migrateForceClose = true;
+}
+
+void TCPSocket::finishMigration()
+{
+    //close e dar jaryan e migrate (ya adopt e na movafagh), hala too thread e target
+    if (m_migrateClose) {
+        bool force = m_migrateForceClose;
+        m_migrateClose = m_migrateForceClose = false;
+        close(force);
+        return;
+    }
+
+    updateLastActive();
+    startIdleTimer(idleTimeout());
+    if (m_deadlineKind != DEADLINE_NONE)
+        startDeadline(m_deadlineKind, m_deadlineMs);
+    handleOnMigrated();
+}
+
+bool TCPSocket::sendWhileMigrating(const iovec *iov, int iovcnt)
+{
+    if (m_migrateState.load(std::memory_order_acquire) != MIGRATE_IN_FLIGHT)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_migrateLock);
+    if (m_migrateState.load(std::memory_order_relaxed) != MIGRATE_IN_FLIGHT)
+        return false;
+
+    for (int i = 0; i < iovcnt; i++)
+        m_migrateSendData.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    return true;
+}
+
+bool TCPSocket::closeWhileMigrating(bool force)
+{
+    if (m_migrateState.load(std::memory_order_acquire) != MIGRATE_IN_FLIGHT)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_migrateLock);
+    if (m_migrateState.load(std::memory_order_relaxed) != MIGRATE_IN_FLIGHT)
+        return false;
+
+    m_migrateClose = true;
+    m_migrateForceClose = m_migrateForceClose || force;
+    return true;
+}
+
+bool TCPSocket::pauseWhileMigrating(bool pause)
+{
+    if (m_migrateState.load(std::memory_order_acquire) != MIGRATE_IN_FLIGHT)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_migrateLock);
+        if (m_migrateState.load(std::memory_order_relaxed) != MIGRATE_IN_FLIGHT)
+            return false;
+
+        if (m_readPaused == pause)
+            return true;
+
+        //adopt ba hamin ev.events register mikone
+        m_readPaused = pause;
+        if (pause)
+            m_SocketContext.ev.events &= ~EPOLLIN;
+        else
+            m_SocketContext.ev.events |= EPOLLIN;
+    }
+
+    //callback e app (propagate be peer) bedoone lock
+    if (pause)
+        handleOnPause();
+    else
+        handleOnResume();
+    return true;
+}
+
+void TCPSocket::setIdleTimeout(int secs)
 {
-    if(m_onClose){
-        m_onClose(m_callbacksArg);
-    }else{
-        onClose();
-    }
+    m_idleTimeoutSecs = secs;
+    if (m_pReactor && getStatus() == Connected)
+        startIdleTimer(idleTimeout());
 }
 
-void TCPSocket::handleOnConnectFailed()
+int TCPSocket::idleTimeout() const
 {
-    if(m_onConnectFailed){
-        m_onConnectFailed(m_callbacksArg);
-    }else{
-        onConnectFailed();
-    }
+    if (m_idleTimeoutSecs < 0 && m_pReactor)
+        return m_pReactor->idleTimeout();
+
+    return m_idleTimeoutSecs;
 }
 
-void TCPSocket::handleOnConnecting()
+void TCPSocket::setHandshakeDeadline(int ms)
 {
-    if(m_onConnecting){
+    startDeadline(DEADLINE_HANDSHAKE, ms);
+}
 
-        m_onConnecting(m_callbacksArg);
+void TCPSocket::clearHandshakeDeadline()
+{
+    if (m_deadlineKind == DEADLINE_HANDSHAKE)
+        startDeadline(DEADLINE_NONE, 0);
+}
 
-    }else{
-        onConnecting();
+void TCPSocket::startIdleTimer(int secs)
+{
+    if (secs <= 0) {
+        m_pReactor->timers()->stop(&m_idleTimer);
+        return;
     }
+
+    m_pReactor->timers()->start(&m_idleTimer, secs * 1000, onIdleTimeout, this, true);
 }
 
-void TCPSocket::handleOnConnected()
+void TCPSocket::startDeadline(DeadlineKind kind, int ms)
 {
-    if(m_onConnected){
-        m_onConnected(m_callbacksArg);
-    }else{
-        onConnected();
+    m_deadlineKind = kind;
+    m_deadlineMs = ms;
+    if (!m_pReactor)
+        return;
+
+    if (kind == DEADLINE_NONE) {
+        m_pReactor->timers()->stop(&m_deadlineTimer);
+        return;
     }
-}
 
-void TCPSocket::handleOnPause() {
-    if (m_onPause)
-        m_onPause(m_callbacksArg);
+    m_pReactor->timers()->start(&m_deadlineTimer, ms, onDeadline, this, true);
 }
 
-void TCPSocket::handleOnResume() {
-    if (m_onResume)
-        m_onResume(m_callbacksArg);
+void TCPSocket::stopDeadlines()
+{
+    m_pReactor->timers()->stop(&m_idleTimer);
+    m_pReactor->timers()->stop(&m_deadlineTimer);
+    m_pReactor->timers()->stop(&m_rBufferTimer);
 }
 
-void TCPSocket::pause_reading() {
-    if (!m_pReactor || m_readPaused)
-        return;  // جلوگیری از تکرار
-    printf("pause_reading(%d)\n", m_readPaused);
-    m_readPaused = true;
-    m_pReactor->removeFlags(&m_SocketContext, EPOLLIN);
-    handleOnPause();  // trigger callback
-}
+void TCPSocket::onIdleTimeout(void *p)
+{
+    TCPSocket *pSocket = static_cast<TCPSocket*>(p);
+    if (pSocket->getStatus() != Connected)
+        return;
 
-void TCPSocket::resume_reading() {
-    if (!m_pReactor || !m_readPaused)
+    //lastActive dar hot path faghat neveshte mishe, inja check va dobare arm
+    int idle = pSocket->idleTimeout();
+    uint64_t elapsed = pSocket->m_pReactor->getCachedNow() - pSocket->getLastActiveTime();
+    if (idle > 0 && elapsed < (uint64_t)idle) {
+        pSocket->startIdleTimer(idle - (int)elapsed);
         return;
+    }
 
-    printf("resume_reading()\n");
-    m_readPaused = false;
-    m_pReactor->addFlags(&m_SocketContext, EPOLLIN);
-    handleOnResume();  // trigger callback
+    printf("Idle Timeout: fd=%d\n", pSocket->fd());
+    pSocket->close(true);
+}
+
+void TCPSocket::onDeadline(void *p)
+{
+    TCPSocket *pSocket = static_cast<TCPSocket*>(p);
+    DeadlineKind kind = pSocket->m_deadlineKind;
+    pSocket->m_deadlineKind = DEADLINE_NONE;
+
+    switch (kind) {
+    case DEADLINE_CONNECT:
+        printf("Connect Timeout: fd=%d\n", pSocket->fd());
+        pSocket->onConnectCompleted(ETIMEDOUT);
+        break;
+    case DEADLINE_HANDSHAKE:
+        printf("Handshake Timeout: fd=%d\n", pSocket->fd());
+        pSocket->close(true);
+        break;
+    case DEADLINE_CLOSING:
+        printf("Closing Timeout: fd=%d\n", pSocket->fd());
+        pSocket->close(true);
+        break;
+    default:
+        break;
+    }
 }
 
 int TCPSocket::getErrorCode()
@@ -219,28 +1052,47 @@ int TCPSocket::getErrorCode()
 
 
 void TCPSocket::close(bool force) {
+    //migrate dar jaryan: bad az adopt dar thread e target
+    if (closeWhileMigrating(force))
+        return;
+
+    //Happy Eyeballs: attempt ha baste mishan, fd e khodesh hanooz nist
+    if (m_pEyeballs) {
+        delete m_pEyeballs;
+        m_pEyeballs = nullptr;
+        setStatus(Closed);
+        stopDeadlines();
+        return;
+    }
+
     if (!m_pReactor || m_SocketContext.fd == -1 || getStatus() == Closed)
         return;
 
-    if (m_SocketContext.writeQueue->empty() || force == true) {
+    if (!hasPendingWrite() || force == true) {
         //printf("TCPSocket::close !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! %d \n", fd());
         //
 
         setStatus(Closed);
+        stopDeadlines();
+        if (m_relayPeer) {
+            m_relayPeer->m_relayPeer = nullptr;
+            m_relayPeer = nullptr;
+        }
         //delere from epoll and ConnectionList
         m_pReactor->del_fd(m_SocketContext.fd, true);
 
-        if (m_SocketContext.rBuffer) {
-            m_pReactor->bufferPool()->deallocate(m_SocketContext.rBuffer);
-            m_SocketContext.rBuffer = nullptr;
-        }
+        releaseReadBuffer();
+        stopSplice();
 
-        if (force) {
+        //io_uring: sendmsg e dar jaryan hanooz az chunk ha mikhoone, engine ta completion negah midare
+        if (force && !m_pReactor->holdInflightSend(&m_SocketContext)) {
             m_SocketContext.writeQueue->clear();
         }
 
 
-        ::shutdown(m_SocketContext.fd, SHUT_WR);
+        //detach: socket too process e jadid zende mimoone, FIN nabayad ersal beshe
+        if (!m_detached)
+            ::shutdown(m_SocketContext.fd, SHUT_WR);
         ::close(m_SocketContext.fd);
 
 
@@ -258,7 +1110,8 @@ void TCPSocket::close(bool force) {
         m_pendingClose = true;
         setStatus(Closing);
         updateLastActive();
-        ::shutdown(m_SocketContext.fd, SHUT_WR);  // بستن write، اما fd باز بمونه
+        startDeadline(DEADLINE_CLOSING, CLOSING_TIMEOUT_SECS * 1000);
+        //SHUT_WR inja na: queue/pipe e splice hanooz ersal nashode, FIN bad az khali shodan (finishWrite)
         m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);  // برای خالی کردن queue
         printf("pending close: waiting for queue to drain\n");
 
@@ -269,80 +1122,51 @@ void TCPSocket::close(bool force) {
 
 
 
-void TCPSocket::_connect(const char *hostname, char **ips, size_t count)
+void TCPSocket::_connected(int fd, int err)
 {
-    if (!ips || count == 0) {
-        printf("No result for %s\n", hostname);
-        setStatus(Closed);
-        handleOnConnectFailed();
-        return;
+    //HappyEyeballs kareshoo tamoom karde, inja delete mishe (akharin kar e oon)
+    HappyEyeballs *pEyeballs = m_pEyeballs;
+    m_pEyeballs = nullptr;
+    m_connectLatencyNs = pEyeballs->elapsedNs();
+    size_t fastOpenBytes = pEyeballs->fastOpenBytes();
+    if (fd != -1) {
+        memcpy(&m_SocketContext.peerAddr, &pEyeballs->winnerAddress(), pEyeballs->winnerAddressLength());
+        m_SocketContext.peerAddrLen = pEyeballs->winnerAddressLength();
     }
+    delete pEyeballs;
 
-    // استفاده از اولین IP (برای سادگی؛ می‌تونی چند IP رو امتحان کنی اگر لازم)
-    const char* ip = ips[0];
-    printf("connecting to [%s] (%s:%d)...\n", hostname, ip, m_SocketContext.port);
-
-    // ایجاد سوکت TCP non-blocking
-    m_SocketContext.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
-    if (m_SocketContext.fd == -1) {
-        perror("socket creation failed");
+    if (fd == -1) {
+        printf("connect failed: %s\n", strerror(err));
         setStatus(Closed);
+        stopDeadlines();
         handleOnConnectFailed();
         return;
     }
 
-    // تنظیم گزینه‌های سوکت
-    TCPSocket::setSocketNoDelay(m_SocketContext.fd, true);
-    //SocketBase::setSocketLowDelay(m_SocketContext.fd, true);
-    //TCPSocket::setSocketKeepAlive(m_SocketContext.fd, true);
-    TCPSocket::setSocketResourceAddress(m_SocketContext.fd, true);
-
-    // آماده‌سازی آدرس
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(m_SocketContext.port);
-    if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0) {
-        // اگر IPv4 نبود، می‌تونی IPv6 رو چک کنی (برای حالا ساده نگه می‌داریم)
-        perror("inet_pton failed (IPv4 assumed)");
-        setStatus(Closing);
-        handleOnConnectFailed();
-        close(true);
-        return;
-    }
-
-    // فراخوانی connect
-    int ret = ::connect(m_SocketContext.fd, (struct sockaddr*)&addr, sizeof(addr));
-    if (ret == 0) {
-        // اتصال فوری موفق (نادر اما ممکن)
-        if(adoptFd(m_SocketContext.fd)){
-            setStatus(Connected);
-            handleOnConnected();
-        }else{
-            setStatus(Closing);
-            handleOnConnectFailed();
-            close(true);
-        }
-
-        return;
-    }
-
-    if (errno == EINPROGRESS) {
-
-        // اتصال در حال انجام (non-blocking)
-        if(adoptFd(m_SocketContext.fd)){
-            //set events
-            m_SocketContext.ev.events = EPOLL_EVENTS_TCP_NONBLOCKING | EPOLLOUT | EPOLLERR;
-
-            bool ret = m_pReactor->register_fd(fd(), &m_SocketContext.ev, IS_TCP_SOCKET, this);
-            if(ret){
-                handleOnConnecting();
-                return;
+    // اتصال برقرار شد: hala socket ba type e khodesh too reactor
+    if (adoptFd(fd)) {
+        setStatus(Connected);
+        m_SocketContext.ev.events = EPOLL_EVENTS_TCP_NONBLOCKING;
+        if (m_pReactor->register_fd(fd, &m_SocketContext.ev, IS_TCP_SOCKET, this)) {
+            if (m_deadlineKind == DEADLINE_CONNECT)
+                startDeadline(DEADLINE_NONE, 0);
+            startIdleTimer(idleTimeout());
+            m_pReactor->telemetry()->connectLatency.record(m_connectLatencyNs);
+            //early data: ghesmati ba SYN rafte, baghie ba EPOLLOUT
+            if (fastOpenBytes > 0) {
+                m_SocketContext.writeQueue->consume(fastOpenBytes);
+                m_pReactor->telemetry()->bytesOut.add(fastOpenBytes);
+                m_pReactor->telemetry()->fastOpenBytes.add(fastOpenBytes);
             }
+            if (!m_SocketContext.writeQueue->empty())
+                m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
+            handleOnConnected();
+            return;
         }
+    } else {
+        m_SocketContext.fd = fd;
     }
 
-    //
     perror("connect failed");
     setStatus(Closing);
     handleOnConnectFailed();
@@ -356,11 +1180,13 @@ void TCPSocket::_accepted(int fd)
         return;
     }
 
-    bool ret = m_pReactor->register_fd(fd, &getSocketContext()->ev, IS_TCP_SOCKET, this);
-    if(ret){
-        if(adoptFd(fd)){
+    // aval adoptFd ke SocketContext.fd set bashe (io_uring op ha too register_fd sakhte mishan)
+    if(adoptFd(fd)){
+        bool ret = m_pReactor->register_fd(fd, &getSocketContext()->ev, IS_TCP_SOCKET, this);
+        if(ret){
 
             setStatus(TCPSocket::Connected);    //or accepted
+            startIdleTimer(idleTimeout());
             handleOnAccepted();  // callback
             return;
         }
@@ -370,7 +1196,7 @@ void TCPSocket::_accepted(int fd)
     close(true);
 }
 
-void TCPSocket::connect_cb(const char *hostname, char **ips, size_t count, DNSLookup::QUERY_TYPE qtype, void *p)
+void TCPSocket::connect_cb(const char * /*hostname*/, char **ips, size_t count, DNSLookup::QUERY_TYPE /*qtype*/, void *p)
 {
     TCPSocket *pSocketBase = static_cast<TCPSocket*>(p);
     if(!pSocketBase){
@@ -378,7 +1204,21 @@ void TCPSocket::connect_cb(const char *hostname, char **ips, size_t count, DNSLo
         return;
     }
 
-    pSocketBase->_connect(hostname, ips, count);
+    //javab e dir: connect tamoom ya baste shode
+    if (!pSocketBase->m_pEyeballs)
+        return;
+
+    pSocketBase->m_pEyeballs->onResolved(DNSLookup::A, ips, count);
+}
+
+void TCPSocket::connect_cb_aaaa(const char * /*hostname*/, char **ips, size_t count, DNSLookup::QUERY_TYPE /*qtype*/, void *p)
+{
+    TCPSocket *pSocketBase = static_cast<TCPSocket*>(p);
+    if (!pSocketBase || !pSocketBase->m_pEyeballs)
+        return;
+
+    //qtype e cache momkene A bashe, query AAAA bood
+    pSocketBase->m_pEyeballs->onResolved(DNSLookup::AAAA, ips, count);
 }
 
 bool TCPSocket::connectTo(const char* host, uint16_t port)
@@ -395,7 +1235,25 @@ bool TCPSocket::connectTo(const char* host, uint16_t port)
 
     setStatus(Connecting);
     m_SocketContext.port = port;
-    return m_pReactor->getIPbyName(host, connect_cb, this);
+    m_pEyeballs = new HappyEyeballs(this, m_pReactor, port);
+    m_pEyeballs->setFastOpen(m_fastOpen);
+    //DNS ham joz e connect hesab mishe
+    startDeadline(DEADLINE_CONNECT, CONNECT_TIMEOUT_MS);
+    handleOnConnecting();
+
+    //ip literal faghat hamoon family, hostname A va AAAA ba ham (Happy Eyeballs)
+    struct in_addr v4;
+    struct in6_addr v6;
+    bool isV4 = inet_pton(AF_INET, host, &v4) == 1;
+    bool isV6 = !isV4 && inet_pton(AF_INET6, host, &v6) == 1;
+    m_pEyeballs->expect(!isV6, !isV4);
+
+    //callback momkene hamin ja seda zade beshe va connect ro tamoom kone
+    if (!isV6 && !m_pReactor->getIPbyName(host, connect_cb, this, DNSLookup::A) && m_pEyeballs)
+        m_pEyeballs->onResolved(DNSLookup::A, nullptr, 0);
+    if (!isV4 && m_pEyeballs && !m_pReactor->getIPbyName(host, connect_cb_aaaa, this, DNSLookup::AAAA) && m_pEyeballs)
+        m_pEyeballs->onResolved(DNSLookup::AAAA, nullptr, 0);
+    return true;
 }
 
 int TCPSocket::fd() const
@@ -415,10 +1273,22 @@ uint64_t TCPSocket::getLastActiveTime()
 
 uint16_t TCPSocket::getLocalPort()
 {
-    struct sockaddr_in local;
+    struct sockaddr_storage local;
     socklen_t len = sizeof(local);
     getsockname(m_SocketContext.fd, (struct sockaddr*)&local, &len);
-    return ntohs(local.sin_port);
+    if (local.ss_family == AF_INET6)
+        return ntohs(reinterpret_cast<struct sockaddr_in6&>(local).sin6_port);
+    return ntohs(reinterpret_cast<struct sockaddr_in&>(local).sin_port);
+}
+
+uint64_t TCPSocket::connectLatencyNs() const
+{
+    return m_connectLatencyNs;
+}
+
+void TCPSocket::setFastOpen(bool enable)
+{
+    m_fastOpen = enable;
 }
 
 void TCPSocket::setOnData(OnDataFn fn, void* Arg) {
@@ -466,6 +1336,11 @@ void TCPSocket::setOnResume(OnResumeFn fn, void* Arg) {
     m_callbacksArg = Arg;
 }
 
+void TCPSocket::setOnMigrated(OnMigratedFn fn, void* Arg) {
+    m_onMigrated = fn;
+    m_callbacksArg = Arg;
+}
+
 
 bool TCPSocket::adoptFd(int fd) {
 
@@ -478,13 +1353,12 @@ bool TCPSocket::adoptFd(int fd) {
 
     m_SocketContext.fd = fd;
     //m_SocketContext.writeBuffer = (char*)::malloc(SLAB_SIZE);
-    m_SocketContext.rBuffer = (char*)m_pReactor->bufferPool()->allocate(SLAB_SIZE);  //(char*)::malloc(SLAB_SIZE);
-    m_SocketContext.rBufferCapacity = SLAB_SIZE;
+    //az RECV_BUFFER_MIN shoroo, ba throughput bozorg mishe
     m_SocketContext.rBufferLength = 0;
     updateLastActive();
 
     //faild allocate
-    if (!m_SocketContext.rBuffer)
+    if (!resizeReadBuffer(RECV_BUFFER_MIN))
     {
         perror("Error allocate failed: ");
         return false;
@@ -495,18 +1369,49 @@ bool TCPSocket::adoptFd(int fd) {
 
 void TCPSocket::onReadable()
 {
+    if (m_splicePeer) {
+        spliceReadable();
+        return;
+    }
+
+    size_t budgetBytes = 0;
+    int budgetCalls = 0;
     while(true)
     {
-        ssize_t bytesRec = ::recv(m_SocketContext.fd, m_SocketContext.rBuffer + m_SocketContext.rBufferLength, m_SocketContext.rBufferCapacity - m_SocketContext.rBufferLength -1, 0);
+        // EPOLLET: baghie data baad az batch khoonde mishe ta socket haye dige montazer naman
+        if (budgetBytes >= READ_BUDGET_BYTES || budgetCalls >= READ_BUDGET_CALLS) {
+            m_pReactor->scheduleRead(&m_SocketContext);
+            break;
+        }
+        budgetCalls++;
+
+        //frame e naghes kole rBuffer ro gerefte
+        if (m_SocketContext.rBufferLength == m_SocketContext.rBufferCapacity &&
+            !reserveReadBuffer(m_SocketContext.rBufferLength + RECV_BUFFER_MIN)) {
+            printf("receive buffer overflow fd=%d len=%zu\n", m_SocketContext.fd, m_SocketContext.rBufferLength);
+            close(true);
+            break;
+        }
+
+        size_t space = m_SocketContext.rBufferCapacity - m_SocketContext.rBufferLength;
+        ssize_t bytesRec = ::recv(m_SocketContext.fd, m_SocketContext.rBuffer + m_SocketContext.rBufferLength, space, 0);
 
         if(bytesRec > 0)  {
             //recBytes += bytesRec;
 
             m_SocketContext.rBufferLength += (size_t) bytesRec;
+            budgetBytes += (size_t) bytesRec;
+            m_pReactor->telemetry()->bytesIn.add((uint64_t)bytesRec);
             //m_SocketContext.rBuffer[m_SocketContext.rBufferLength] = 0;
             updateLastActive();
-            handleOnData(reinterpret_cast<uint8_t*>(m_SocketContext.rBuffer), m_SocketContext.rBufferLength);  // hot-path via fn pointer
-            m_SocketContext.rBufferLength = 0; // app consumed in this skeleton
+            consumeReadBuffer(handleOnData(reinterpret_cast<uint8_t*>(m_SocketContext.rBuffer), m_SocketContext.rBufferLength));  // hot-path via fn pointer
+            if (!m_SocketContext.rBuffer)
+                break;
+
+            if ((size_t)bytesRec == space)
+                growReadBuffer();
+            else
+                m_fullReads = 0;
 
             if (m_readPaused) {
                 //printf("backpressure pause onReadable\n");
@@ -517,27 +1422,15 @@ void TCPSocket::onReadable()
         }
 
         if(bytesRec == 0) {
-
-            if(!m_pendingClose){
-                //printf("bytesRec == 0 close() %zu----------------------\n", m_SocketContext.writeQueue->size());
-                if (!m_SocketContext.writeQueue->empty()) {
-                    m_pendingClose = true;
-                    //change status for shurdown
-                    setStatus(Closing);
-                    updateLastActive();
-
-                    //faal shodane EPOLLOUT baraye khali kardane safe ersal
-                    m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
-                }else{
-                    close(true);
-                }
-            }
+            handleReadEof();
             break;
         }
 
         if(bytesRec < 0) {
-            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                m_pReactor->telemetry()->recvEagain.add(1);
                 break;
+            }
 
             close(true);
             break;
@@ -546,28 +1439,171 @@ void TCPSocket::onReadable()
 }
 
 
+void TCPSocket::handleReadEof()
+{
+    if(!m_pendingClose){
+        //printf("bytesRec == 0 close() %zu----------------------\n", m_SocketContext.writeQueue->size());
+        if (hasPendingWrite()) {
+            m_pendingClose = true;
+            //change status for shurdown
+            setStatus(Closing);
+            updateLastActive();
+            startDeadline(DEADLINE_CLOSING, CLOSING_TIMEOUT_SECS * 1000);
+
+            //faal shodane EPOLLOUT baraye khali kardane safe ersal
+            m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
+        }else{
+            close(true);
+        }
+    }
+}
+
+void TCPSocket::onRecvCompleted(const uint8_t *data, int res)
+{
+    if (res > 0) {
+        updateLastActive();
+        m_pReactor->telemetry()->bytesIn.add((uint64_t)res);
+
+        if (m_SocketContext.rBufferLength == 0) {
+            //mostaghim az buffer e ring, faghat tail e naghes copy mishe (buffer be ring barmigarde)
+            size_t consumed = handleOnData(data, (size_t)res);
+            size_t rest = (size_t)res - consumed;
+            if (!rest || !m_SocketContext.rBuffer)
+                return;
+
+            if (!reserveReadBuffer(rest)) {
+                close(true);
+                return;
+            }
+            memcpy(m_SocketContext.rBuffer, data + consumed, rest);
+            m_SocketContext.rBufferLength = rest;
+            return;
+        }
+
+        if (!reserveReadBuffer(m_SocketContext.rBufferLength + (size_t)res)) {
+            printf("receive buffer overflow fd=%d len=%zu\n", m_SocketContext.fd, m_SocketContext.rBufferLength);
+            close(true);
+            return;
+        }
+        memcpy(m_SocketContext.rBuffer + m_SocketContext.rBufferLength, data, (size_t)res);
+        m_SocketContext.rBufferLength += (size_t)res;
+        consumeReadBuffer(handleOnData(reinterpret_cast<uint8_t*>(m_SocketContext.rBuffer), m_SocketContext.rBufferLength));
+        return;
+    }
+
+    if (res == 0) {
+        handleReadEof();
+        return;
+    }
+
+    // ENOBUFS: buffer ring khali bood, engine dobare arm mikone
+    if (res == -EAGAIN || res == -EINTR || res == -ENOBUFS)
+        return;
+
+    close(true);
+}
+
+void TCPSocket::onSendCompleted(int res)
+{
+    if (res < 0) {
+        if (res == -EAGAIN || res == -EINTR)
+            return;
+
+        printf("error sendmsg: %s\n", strerror(-res));
+        close(true);
+        return;
+    }
+
+    updateLastActive();
+    m_pReactor->telemetry()->bytesOut.add((uint64_t)res);
+    consumeSent((size_t)res);
+    finishWrite();
+}
+
+void TCPSocket::onConnectCompleted(int err)
+{
+    if (err != 0) {
+        printf("connect failed: %s\n", strerror(err));
+        handleOnConnectFailed();
+        close(true);  // Force close برای خطاها
+        return;
+    }
+
+    // remove EPOLLOUT
+    m_pReactor->removeFlags(&m_SocketContext, EPOLLOUT);
+
+    //connected sucessfully
+    setStatus(Connected);
+    if (m_deadlineKind == DEADLINE_CONNECT)
+        startDeadline(DEADLINE_NONE, 0);
+    startIdleTimer(idleTimeout());
+    handleOnConnected();
+}
+
 void TCPSocket::send(const void* data, size_t len) {
+    struct iovec iov = {const_cast<void*>(data), len};
+    send(&iov, 1);
+}
+
+void TCPSocket::send(const iovec *iov, int iovcnt) {
+    sendIov(iov, iovcnt, nullptr);
+}
+
+void TCPSocket::sendFrom(TCPSocket *source, const void *data, size_t len) {
+    const char *p = static_cast<const char*>(data);
+    const SocketContext &src = source->m_SocketContext;
+    //slab faghat too hamin shard (BufferPool e moshtarak); io_uring momkene az provided buffer bede
+    bool inReadBuffer = src.rBuffer && p >= src.rBuffer && p + len <= src.rBuffer + src.rBufferLength;
+    bool worthSharing = len >= std::max(SHARED_SEND_MIN_BYTES, src.rBufferCapacity / 4);
+    struct iovec iov = {const_cast<void*>(data), len};
+    //migrate dar jaryan: m_pReactor male thread e dige ast, copy mishe
+    if (sendWhileMigrating(&iov, 1))
+        return;
+    sendIov(&iov, 1, (source->m_pReactor == m_pReactor && inReadBuffer && worthSharing) ? src.rBuffer : nullptr);
+}
+
+void TCPSocket::sendIov(const iovec *iov, int iovcnt, void *slab) {
     //printf("TCPSocket::send getStatus: %u\n", getStatus());
-    if (!data || len == 0 || !m_pReactor)
+    if (!iov || iovcnt <= 0 || sendWhileMigrating(iov, iovcnt) || !m_pReactor)
+        return;
+
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++)
+        len += iov[i].iov_len;
+    if (len == 0)
         return;
 
-    while (len > 0 && m_SocketContext.writeQueue->empty()) {
-        ssize_t n = ::send(m_SocketContext.fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    //queue khali: kole frame (header + payload) ba yek sendmsg
+    //auto-cork: hamash queue mishe, akhare dor e reactor ba ham ersal mishan
+    //ghabl az connect (early data): fd nadarim, queue mishe ta SYN (fast open) ya _connected
+    bool early = getStatus() == Ready || getStatus() == Connecting;
+    bool corked = m_autoCork && getStatus() == Connected;
+    size_t sent = 0;
+    while (!corked && !early && m_SocketContext.writeQueue->empty()) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = const_cast<iovec*>(iov);
+        msg.msg_iovlen = (size_t)iovcnt;
+
+        ssize_t n = ::sendmsg(m_SocketContext.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
         //printf("TCPSocket::send n: %zd\n", n);
         if (n > 0) {
 
             //sndBytes += n;
-            data = (const char*)data + n;
-            len -= (size_t)n;
+            m_pReactor->telemetry()->bytesOut.add((uint64_t)n);
+            sent = (size_t)n;
             updateLastActive();
-            if (len == 0)
+            if (sent == len)
                 return; // hame ersal shod
             break;
         }
 
         if (n == -1) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                m_pReactor->telemetry()->sendEagain.add(1);
                 break; // kernel buffer por shod
+            } else if (errno == EINTR) {
+                continue;
             } else {
                 close(true);
                 return;
@@ -590,11 +1626,33 @@ void TCPSocket::send(const void* data, size_t len) {
     */
 
     /**/
-    if (len > 0) {
-        m_SocketContext.writeQueue->push(data, len); // add to Queue list
+    if (sent < len) {
+        //faghat baghie ye ersal nashode too queue
+        for (int i = 0; i < iovcnt; i++) {
+            size_t blen = iov[i].iov_len;
+            if (sent >= blen) {
+                sent -= blen;
+                continue;
+            }
+            const char *rest = static_cast<const char*>(iov[i].iov_base) + sent;
+            if (slab) {
+                //rBuffer e source: bedoone copy, source baad az callback slab e jadid migire
+                m_SocketContext.writeQueue->pushShared(slab, rest, blen - sent);
+                m_pReactor->telemetry()->sharedBytes.add(blen - sent);
+            } else {
+                m_SocketContext.writeQueue->push(rest, blen - sent); // add to Queue list
+            }
+            sent = 0;
+        }
+
+        if (early)
+            return;
 
         // harvaght ke data too queue hast, EPOLLOUT ro fa'al mikonim.
-        m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
+        if (corked && !(m_SocketContext.ev.events & EPOLLOUT))
+            m_pReactor->scheduleFlush(&m_SocketContext);
+        else
+            m_pReactor->addFlags(&m_SocketContext, EPOLLOUT);
 
         if (m_SocketContext.writeQueue->size() > BACK_PRESSURE) {
             // Backpressure faqhat rooye ghesmat daryaft dadeh (read) ta'sir dare.
@@ -620,20 +1678,7 @@ void TCPSocket::onWritable() {
 
     // tashkhise inke darim connect mishim ya na #mohem
     if (getStatus() == Connecting && !m_pendingClose) {
-
-        if (err != 0) {
-            printf("connect failed: %s\n", strerror(err));
-            handleOnConnectFailed();
-            close(true);  // Force close برای خطاها
-            return;
-        }
-
-        // remove EPOLLOUT
-        m_pReactor->removeFlags(&m_SocketContext, EPOLLOUT);
-
-        //connected sucessfully
-        setStatus(Connected);
-        handleOnConnected();
+        onConnectCompleted(err);
         return;
     }
 
@@ -646,81 +1691,72 @@ void TCPSocket::onWritable() {
 
 
 
+    if (!writeQueued())
+        return;
+
+    printf("iov End: %zd , empty: %d\n", m_SocketContext.writeQueue->size(), m_SocketContext.writeQueue->empty());
+    if (m_splicePending) {
+        flushSplice();
+        if (getStatus() == Closed)
+            return;
+    }
+    finishWrite();
+}
+
+bool TCPSocket::writeQueued()
+{
     // ادامه کد اصلی برای ارسال داده‌ها (با بهبود: استفاده از sendmsg و iovec برای batch)
-    const size_t MAX_BATCH_BYTES = 256 * 1024; //256KB tunable: max bytes per sendmsg
-#ifdef IOV_MAX
-    const size_t MAX_IOV = IOV_MAX;
-#else
-    const size_t MAX_IOV = 1024;
-#endif
+    //iovec ha rooye stack, har dor allocate nadarim
+    struct iovec iov[SEND_MAX_IOV];
+    struct msghdr msg;
 
     while (!m_SocketContext.writeQueue->empty()) {
         printf("begin writing...\n");
 
-        // ساخت iovec از queue
-        std::vector<struct iovec> iov;
-        iov.reserve(std::min<size_t>(MAX_IOV, m_SocketContext.writeQueue->count()));
-
         size_t batch_bytes = 0;
-        for (auto it = m_SocketContext.writeQueue->begin(); it != m_SocketContext.writeQueue->end() && iov.size() < MAX_IOV; ++it) {
-            size_t blen = it->len;
-            if (blen == 0)
-                continue;
-
-            if (!iov.empty() && batch_bytes + blen > MAX_BATCH_BYTES){
-                printf("cod 01, iov.empty:[%d], batch_bytes:[%zu]\n", iov.empty(), batch_bytes + blen);
-                break;
-            }
-
-            iov.push_back({it->data, blen});
-            batch_bytes += blen;
-
-            if (batch_bytes >= MAX_BATCH_BYTES){
-                printf("cod 02\n");
-                break;
-            }
-        }
-
-        if (iov.empty()){
-            printf("cod 03\n");
+        size_t iovCount = m_SocketContext.writeQueue->fillIov(iov, SEND_MAX_IOV, MAX_SEND_BATCH_BYTES, batch_bytes);
+        if (iovCount == 0)
             break;
-        }
 
         // sendmsg
-        struct msghdr msg;
         memset(&msg, 0, sizeof(msg));
-        msg.msg_iov = iov.data();
-        msg.msg_iovlen = iov.size();
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovCount;
 
-        ssize_t bytesSent = ::sendmsg(m_SocketContext.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        //batch e bozorg: kernel mostaghim az block haye pool mikhoone
+        bool zeroCopy = m_zeroCopy && batch_bytes >= ZEROCOPY_MIN_BYTES && enableZeroCopy();
+        ssize_t bytesSent = ::sendmsg(m_SocketContext.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | (zeroCopy ? MSG_ZEROCOPY : 0));
         printf("bytesSent: %zd\n", bytesSent);
         if (bytesSent > 0) {
             //sndBytes += bytesSent;
             updateLastActive();
-            size_t remaining = static_cast<size_t>(bytesSent);
-
-            // مصرف از queue
-            while (remaining > 0 && !m_SocketContext.writeQueue->empty()) {
-                auto &buf = m_SocketContext.writeQueue->front();
-                if (remaining >= buf.len) {
-                    remaining -= buf.len;
-                    m_SocketContext.writeQueue->pop_front();
-
-                    //printf("writeQueue->pop_front(): [%zu] remaining[%zu]\n", m_SocketContext.writeQueue->size() , remaining );
-                } else {
-
-                    memmove(buf.data, static_cast<char*>(buf.data) + remaining, buf.len - remaining);
-                    buf.len -= remaining;
-                    remaining = 0;
-                }
+            m_pReactor->telemetry()->bytesOut.add((uint64_t)bytesSent);
+            if (zeroCopy) {
+                m_zeroCopySeq++;
+                m_pReactor->telemetry()->zeroCopySends.add(1);
             }
 
+            // مصرف از queue
+            consumeSent(static_cast<size_t>(bytesSent), zeroCopy);
             continue;
         }
 
+        //optmem_max por shode, in batch bedoone zerocopy
+        if (bytesSent == -1 && errno == ENOBUFS && zeroCopy) {
+            ssize_t copied = ::sendmsg(m_SocketContext.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (copied > 0) {
+                updateLastActive();
+                m_pReactor->telemetry()->bytesOut.add((uint64_t)copied);
+                consumeSent(static_cast<size_t>(copied));
+                continue;
+            }
+            bytesSent = copied;
+        }
+
         if (bytesSent == -1) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 printf("write get EAGAIN\n");
+                m_pReactor->telemetry()->sendEagain.add(1);
                 break;
 
             } else if (errno == EINTR) {
@@ -729,13 +1765,21 @@ void TCPSocket::onWritable() {
             } else {
                 perror("error sendmsg");
                 close(true);
-                return;
+                return false;
             }
         }
     }
+    return true;
+}
 
-    printf("iov End: %zd , empty: %d\n", m_SocketContext.writeQueue->size(), m_SocketContext.writeQueue->empty());
+void TCPSocket::consumeSent(size_t bytesSent, bool zeroCopy)
+{
+    //chunk haye zerocopy ta completion e akharin seq negah dashte mishan
+    m_SocketContext.writeQueue->consume(bytesSent, zeroCopy, m_zeroCopySeq - 1);
+}
 
+void TCPSocket::finishWrite()
+{
     if (!m_SocketContext.writeQueue->empty()) {
         if (!(m_SocketContext.ev.events & EPOLLOUT)){
             //m_pReactor->mod_add(&m_SocketContext, EPOLLOUT);
@@ -753,13 +1797,12 @@ void TCPSocket::onWritable() {
     */
 
     //hazf beshe
-    if (m_SocketContext.writeQueue->empty() && m_pendingClose) {
+    if (!hasPendingWrite() && m_pendingClose) {
         setStatus(Closed);
+        stopDeadlines();
         m_pReactor->del_fd(m_SocketContext.fd, true);
-        if (m_SocketContext.rBuffer) {
-            m_pReactor->bufferPool()->deallocate(m_SocketContext.rBuffer);
-            m_SocketContext.rBuffer = nullptr;
-        }
+        releaseReadBuffer();
+        stopSplice();
         ::close(m_SocketContext.fd);  // حذف SHUT_RDWR
         printf("graceful close: queue drained-------------------------------------------------------------------------------\n");
         handleOnClose();
@@ -773,14 +1816,17 @@ void TCPSocket::onWritable() {
         resume_reading();
     }
 
-    // vaghti ke saf khali shod EPOLLOUT disable beshe
-    if (m_SocketContext.writeQueue->empty()) {
+    // vaghti ke saf khali shod EPOLLOUT disable beshe (completion e zerocopy ba EPOLLERR miad)
+    if (m_SocketContext.writeQueue->empty() && !m_splicePending) {
         m_pReactor->removeFlags(&m_SocketContext, EPOLLOUT);
         // agar Reading az ghabl pause shode bod resume beshe
         if (m_readPaused) {
             printf("Write queue drained, resuming reading.\n");
             resume_reading();
         }
+        //splice: peer ba pipe e por pause shode bood
+        if (m_splicePeer && m_splicePeer->m_readPaused)
+            m_splicePeer->resume_reading();
     }
 
 }
@@ -791,7 +1837,7 @@ void TCPSocket::handleHalfClose() {
     ssize_t ret = ::recv(m_SocketContext.fd, buf, 1, MSG_PEEK | MSG_DONTWAIT);
     if (ret == 0) {
 
-        if (m_SocketContext.writeQueue && m_SocketContext.writeQueue->empty()) {
+        if (m_SocketContext.writeQueue && !hasPendingWrite()) {
             //safe ersal khalie force close beshe
             close(true);
             return;
@@ -799,6 +1845,7 @@ void TCPSocket::handleHalfClose() {
             m_pendingClose = true;
             setStatus(Closing);
             updateLastActive();
+            startDeadline(DEADLINE_CLOSING, CLOSING_TIMEOUT_SECS * 1000);
             m_pReactor->addFlags(&m_SocketContext, EPOLLOUT); // فعال کردن اگر لازم
             printf("add EPOLLOUT TCPSocket::handleHalfClose() %zu\n", m_SocketContext.writeQueue->size());
         }
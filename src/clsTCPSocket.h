@@ -2,15 +2,20 @@
 #define CLSTCPSOCKET_H
 //
 #include "epoll.h"
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <sys/epoll.h>
 #include <string>
+#include <vector>
 #include "SocketContext.h"
 #include "clsDNSLookup.h"
+#include "clsTimerManager.h"
 
 class Server;
 class EpollReactor;
+class HappyEyeballs;
 class TCPSocket
 {
 public:
@@ -25,7 +30,8 @@ public:
 
     void setReactor(EpollReactor* r);
 
-    using OnDataFn = void(*)(void* , const uint8_t* data, size_t len);
+    // return: tedad byte e masraf shode, baghie too rBuffer mimoone va dafe badi az aval miad
+    using OnDataFn = size_t(*)(void* , const uint8_t* data, size_t len);
     //using OnConnectingFn = void(*)(void* routin, void* p);
     using OnConnectingFn = void(*)(void* p);
 
@@ -36,6 +42,7 @@ public:
 
     using OnPauseFn = void(*)(void* p);
     using OnResumeFn = void(*)(void* p);
+    using OnMigratedFn = void(*)(void* p);
 
 
     void setOnData(OnDataFn fn, void *Arg);
@@ -48,18 +55,20 @@ public:
 
     void setOnPause(OnPauseFn fn, void* Arg);
     void setOnResume(OnResumeFn fn, void* Arg);
+    void setOnMigrated(OnMigratedFn fn, void* Arg);
 
 
     //using CloseCallback = std::function<void(int)>;                   // fd
     //using EpollModCallback = std::function<void(int, uint32_t)>;      // fd, newFlags
 
-    virtual~TCPSocket() =  default; // (13) RAII
+    virtual~TCPSocket(); // (13) RAII
     virtual void onAccepted() {}                                // (non-hot)
     virtual void onClose() {}                                   // (non-hot)
     virtual void onConnectFailed(){}  // (non-hot)
     virtual void onConnecting(){}
     virtual void onConnected(){}
-    virtual void onReceiveData(const uint8_t* Data, size_t len){}
+    virtual size_t onReceiveData(const uint8_t* Data, size_t len){ return len; }
+    virtual void onMigrated(){}                                 // dar thread e shard e jadid
 
 
     // setter hot path entry — called by shard on EPOLLIN
@@ -67,13 +76,67 @@ public:
     void onWritable();
     void handleHalfClose();
 
+    // completion entry — called by the io_uring backend
+    void onRecvCompleted(const uint8_t *data, int res);
+    void onSendCompleted(int res);
+    void onConnectCompleted(int err);
+
     //void setCloseCallback(CloseCallback cb);
     //void setEpollModCallback(EpollModCallback cb);
 
     // app-side send helper (thread-affinity: shard thread)
     void send(const void * data, size_t len);
+    // scatter-gather: queue khali bashe yek sendmsg, faghat baghie ye ersal nashode queue mishe
+    void send(const struct iovec * iov, int iovcnt);
+    // relay: data dakhele rBuffer e source (too onReceiveData e source, hamin shard). baghie ye ersal nashode
+    // ba reference be slab e source queue mishe (copy nemishe), source baad az callback slab e jadid migire
+    void sendFrom(TCPSocket * source, const void * data, size_t len);
     void close(bool force = false);
+    // hot upgrade: fd be process e jadid rafte, inja bedoone shutdown() baste mishe
+    void detach();
+    // app mige connection dar marz e protocol hast (state nadare) va mitoone handoff beshe
+    void setHandoffIdle(bool isIdle);
+    bool isHandoffIdle() const;
+    // rebalance: socket (fd, read buffer, SendQueue, SockInfo) be shard e dige mire.
+    // dar thread e shard e feli, akhare hamin dor anjam mishe; az oon ta onMigrated() (dar thread e target)
+    // send() ha be data e montaghel shode ezafe mishan va close() ta adopt defer mishe.
+    // peer: do tarafe relay (ba ham rooye yek shard) dar yek dor va yek task montaghel mishan,
+    // bedoone peer, socket nabayad peer i rooye shard e feli dashte bashe
+    bool migrateTo(EpollReactor *target, TCPSocket *peer = nullptr);
+    // tarafe dige ye relay baraye rebalance (EpollReactor::rebalanceTo), close pak mikone
+    void setRelayPeer(TCPSocket *peer);
+    TCPSocket *relayPeer() const;
+    // relay e kernel: byte ha ba splice() az pipe e har samt mostaghim be peer miran va vared e user space nemishan.
+    // har do Connected rooye yek shard (faghat epoll), bad az in onReceiveData seda zade nemishe.
+    // backpressure: pipe e peer por bashe pause_reading(), khali beshe resume_reading() (hamoon callback ha)
+    bool spliceWith(TCPSocket *peer);
+    bool isSpliced() const;
+    // writeQueue ya pipe e splice khali nist, ya MSG_ZEROCOPY completion nayomade
+    bool hasPendingWrite() const;
+    // batch haye >= ZEROCOPY_MIN_BYTES dar onWritable ba MSG_ZEROCOPY (faghat epoll),
+    // block haye SendQueue ta completion az MSG_ERRQUEUE azad nemishan
+    void setZeroCopy(bool enable);
+    // auto-cork: send() dar callback ha faghat queue mikone, akhare dor e reactor yek sendmsg
+    // (chand frame e koochik -> yek segment). kami latency dar ezaye syscall/packet e kamtar
+    void setAutoCork(bool enable);
+    // reactor akhare dor seda mizane (runFlushList)
+    void flushCorked();
+    // EPOLLERR: completion haye MSG_ZEROCOPY ro mikhoone, false = error e vagheyi
+    bool readErrorQueue();
+    // Happy Eyeballs (RFC 8305): A va AAAA ba ham, connect ha ba fasele HE_ATTEMPT_DELAY_MS
+    // rooye hame address ha, avalin connect barande. CONNECT_TIMEOUT_MS az hamin ja (DNS ham)
     bool connectTo(const char *host, uint16_t port);
+    // TCP Fast Open baraye connectTo: byte haye send() shode ghabl az connect (early data) ba SYN e
+    // avalin attempt miran (TCP_FASTOPEN_CONNECT). faghat baraye protocol e idempotent, SYN momkene tekrar beshe
+    void setFastOpen(bool enable);
+    // az connectTo ta connect (DNS + mosabeghe), dar onConnected/onConnectFailed dorost e
+    uint64_t connectLatencyNs() const;
+    // deadline ha rooye timing wheel e shard, faghat vaghti moghe'esh beresad fire mishan
+    // idle: az lastActive, -1 = default e reactor, 0 = khamoosh
+    void setIdleTimeout(int secs);
+    // app (masalan SOCKS) ta clearHandshakeDeadline() bayad handshake ro tamoom kone, vagarna close
+    void setHandshakeDeadline(int ms);
+    void clearHandshakeDeadline();
 
 
     // accessors
@@ -93,6 +156,14 @@ public:
     static void setSocketCork(int fd, bool isEnable);
     static void setSocketKeepAlive(int fd, bool isEnable);
     static void setSocketLowDelay(int fd, bool isEnable);
+    static void setSocketIncomingCpu(int fd, int cpu);
+    static void setSocketBusyPoll(int fd, int usec);
+    // listener: TCP_FASTOPEN ba queue e SYN haye data dar (0 = khamoosh)
+    static void setSocketFastOpen(int fd, int queueLen);
+    // ghabl az connect(): ba cookie, connect defer mishe va avalin sendmsg ba SYN miad
+    static bool setSocketFastOpenConnect(int fd, bool isEnable);
+    // shardCpus[i] = cpu e socket e i dar reuseport group (tartib e listen)
+    static bool attachCpuSteering(int fd, const std::vector<int> &shardCpus);
 
 
     SocketContext *getSocketContext() ;
@@ -104,6 +175,9 @@ public:
     socketStatus getStatus() const;
     EpollReactor *getReactor() const;
     void _accepted(int fd);
+    void _migrate(EpollReactor *target, TCPSocket *peer);
+    // HappyEyeballs: fd e barande, -1 = hame address ha shekast (err)
+    void _connected(int fd, int err);
 
 protected:
     OnDataFn m_onData { nullptr };
@@ -115,24 +189,95 @@ protected:
 
     OnPauseFn m_onPause { nullptr };
     OnResumeFn m_onResume { nullptr };
+    OnMigratedFn m_onMigrated { nullptr };
 
     //argumnets
     void* m_callbacksArg { nullptr };
 
     struct SocketContext m_SocketContext {}; // composition with low-level TCP
-    void _connect(const char *hostname, char **ips, size_t count);
     void setStatus(socketStatus newStatus);
 private:
     EpollReactor* m_pReactor = nullptr;
     bool m_readPaused { false };
     bool m_pendingClose { false };
+    bool m_handoffIdle { false };
+    bool m_detached { false };
+    enum MigrateState : uint8_t {
+        MIGRATE_NONE = 0,
+        MIGRATE_SCHEDULED = 1,      // ta akhare dor, hanooz too shard e feli
+        MIGRATE_IN_FLIGHT = 2       // task e adopt dar target post shode
+    };
+    // data e socket az shard e ghadimi be task e target (BufferPool e har shard joda)
+    struct MigratedData {
+        std::string readData;
+        std::string sendData;
+    };
+    std::atomic<uint8_t> m_migrateState { MIGRATE_NONE };
+    // in flight: send/close/pause az shard e ghadimi inja jam mishan, adopt zir e hamin lock
+    std::mutex m_migrateLock;
+    std::string m_migrateSendData;
+    bool m_migrateClose { false };
+    bool m_migrateForceClose { false };
+    TCPSocket *m_relayPeer { nullptr };
+
+    enum DeadlineKind : uint8_t {
+        DEADLINE_NONE = 0,
+        DEADLINE_CONNECT = 1,
+        DEADLINE_HANDSHAKE = 2,
+        DEADLINE_CLOSING = 3
+    };
+    TimerNode m_idleTimer;
+    TimerNode m_deadlineTimer;              // connect -> handshake -> closing, har bar yeki
+    TimerNode m_rBufferTimer;               // rBuffer > RECV_BUFFER_MIN, idle -> koochik
+    TCPSocket *m_splicePeer { nullptr };
+    int m_splicePipe[2] { -1, -1 };         // byte haye peer ke montazer e ersal be in socket hastan
+    size_t m_splicePending { 0 };
+    bool m_autoCork { false };
+    bool m_fastOpen { false };
+    bool m_zeroCopy { false };
+    bool m_zeroCopyEnabled { false };       // SO_ZEROCOPY set shode
+    uint8_t m_zeroCopyCopied { 0 };         // completion e COPIED poshte sar ham
+    uint32_t m_zeroCopySeq { 0 };           // seq e sendmsg e zerocopy e badi (mesle kernel)
+    uint32_t m_zeroCopyCompleted { 0 };     // hame seq haye ghabl az in tamoom shodan
+    std::vector<std::pair<uint32_t, uint32_t>> m_zeroCopyRanges;   // completion e kharej az tartib
+    uint8_t m_fullReads { 0 };              // recv haye poshte sar ham ke buffer ro por kardan
+    DeadlineKind m_deadlineKind { DEADLINE_NONE };
+    int m_deadlineMs { 0 };
+    int m_idleTimeoutSecs { -1 };
     socketStatus status {Ready};
+    HappyEyeballs *m_pEyeballs { nullptr };     // faghat dar hale connect
+    uint64_t m_connectLatencyNs { 0 };
 
     void updateLastActive();
+    void handleReadEof();
+    void consumeSent(size_t bytesSent, bool zeroCopy = false);
+    // sendmsg ta khali shodan e queue ya EAGAIN, false = socket baste shod
+    bool writeQueued();
+    // slab != nullptr: iov ha dakhele slab e shared, baghie ba pushShared
+    void sendIov(const struct iovec *iov, int iovcnt, void *slab);
+    bool enableZeroCopy();
+    void onZeroCopyCompleted(uint32_t lo, uint32_t hi, bool copied);
+    void finishWrite();
+    int idleTimeout() const;
+    void startIdleTimer(int secs);
+    void startDeadline(DeadlineKind kind, int ms);
+    void stopDeadlines();
+    static void onIdleTimeout(void *p);
+    static void onDeadline(void *p);
 
     //CloseCallback close_cb_{};
     //EpollModCallback epoll_mod_cb_{};
-    void handleOnData(const uint8_t * d, size_t n);
+    size_t handleOnData(const uint8_t * d, size_t n);
+    bool reserveReadBuffer(size_t needed);
+    void consumeReadBuffer(size_t consumed);
+    bool resizeReadBuffer(size_t capacity);
+    void releaseReadBuffer();
+    void growReadBuffer();
+    static void onReadBufferIdle(void *p);
+    bool openSplicePipe();
+    void stopSplice();
+    void spliceReadable();
+    void flushSplice();
     void handleOnAccepted();
     void handleOnClose();
     void handleOnConnectFailed();
@@ -140,8 +285,18 @@ private:
     void handleOnConnected();
     void handleOnPause();
     void handleOnResume();
+    void handleOnMigrated();
+    bool canMigrate(EpollReactor *target) const;
+    bool detachForMigration(MigratedData &data);
+    void adoptMigrated(EpollReactor *target, const MigratedData &data);
+    void finishMigration();
+    // in flight: true = kar anjam shod (ba lock), socket dast nakhore
+    bool sendWhileMigrating(const struct iovec *iov, int iovcnt);
+    bool closeWhileMigrating(bool force);
+    bool pauseWhileMigrating(bool pause);
 
     static void connect_cb(const char *hostname, char **ips, size_t count, DNSLookup::QUERY_TYPE qtype, void *p);
+    static void connect_cb_aaaa(const char *hostname, char **ips, size_t count, DNSLookup::QUERY_TYPE qtype, void *p);
 
 };
 
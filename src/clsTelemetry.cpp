@@ -0,0 +1,78 @@
+#include "clsTelemetry.h"
+#include <cstdio>
+
+int LatencyHistogram::bucketOf(uint64_t value)
+{
+    if (value < SUB_COUNT)
+        return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int)((value >> (msb - SUB_BITS)) & (SUB_COUNT - 1));
+    return (msb - SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SUB_COUNT)
+        return (uint64_t)index;
+
+    int msb = index / SUB_COUNT + SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(index % SUB_COUNT);
+    uint64_t low = (1ULL << msb) | (sub << (msb - SUB_BITS));
+    return low + (1ULL << (msb - SUB_BITS)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_ns)
+{
+    std::atomic<uint64_t> &bucket = m_counts[bucketOf(value_ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_total.store(m_total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (value_ns > m_max.load(std::memory_order_relaxed))
+        m_max.store(value_ns, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    return m_total.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t total = count();
+    if (total == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)(total * p / 100.0);
+    if (target == 0)
+        target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+            return bucketUpperBound(i);
+    }
+
+    return max();
+}
+
+void ShardTelemetry::print(int shardID) const
+{
+    uint64_t w = waits.get();
+    printf("shard[%d]: accepts=%lu waits=%lu events=%lu (%.1f/wait) ctl=%lu in=%lu out=%lu eagain(r/w)=%lu/%lu zc=%lu/%lu ref=%lu tfo=%lu pause/resume=%lu/%lu pool=%lu rbuf=%lu gc=%lu\n",
+           shardID, accepts.get(), w, events.get(), w ? (double)events.get() / w : 0.0, epollCtl.get(),
+           bytesIn.get(), bytesOut.get(), recvEagain.get(), sendEagain.get(), zeroCopySends.get(), zeroCopyCopied.get(), sharedBytes.get(), fastOpenBytes.get(),
+           pauses.get(), resumes.get(), bufferPoolInUse.get(), recvBufferBytes.get(), gcQueueLength.get());
+    printf("shard[%d]: loop ns p50=%lu p99=%lu p99.9=%lu max=%lu (n=%lu)\n",
+           shardID, loopLatency.percentile(50), loopLatency.percentile(99), loopLatency.percentile(99.9),
+           loopLatency.max(), loopLatency.count());
+    if (connectLatency.count())
+        printf("shard[%d]: connect ns p50=%lu p99=%lu max=%lu (n=%lu)\n",
+               shardID, connectLatency.percentile(50), connectLatency.percentile(99),
+               connectLatency.max(), connectLatency.count());
+}
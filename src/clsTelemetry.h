@@ -0,0 +1,68 @@
+#ifndef CLSTELEMETRY_H
+#define CLSTELEMETRY_H
+// ============================== Telemetry (16) ===============================
+// Counter haye har shard. faghat thread e shard minevise (relaxed load+store,
+// bedoone lock prefix), har thread dige bedoone lock mikhoone.
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// HDR-style: bucket = (msb, 3 bit e badi), deghat ~12% az 1ns ta ~1 saat
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int BUCKETS = 64 * SUB_COUNT;
+
+    void record(uint64_t value_ns);
+    uint64_t count() const;
+    // percentile 0..100, upper bound e bucket
+    uint64_t percentile(double p) const;
+    uint64_t max() const;
+
+private:
+    std::atomic<uint64_t> m_counts[BUCKETS] {};
+    std::atomic<uint64_t> m_total {0};
+    std::atomic<uint64_t> m_max {0};
+
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+};
+
+// har counter cache line e khodesh, ta khoondan az thread dige false sharing nadashte bashe
+struct alignas(64) TelemetryCounter
+{
+    std::atomic<uint64_t> value {0};
+
+    void add(uint64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void set(uint64_t n) { value.store(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+struct ShardTelemetry
+{
+    TelemetryCounter accepts;
+    TelemetryCounter waits;             // epoll_wait / io_uring_enter
+    TelemetryCounter events;            // events / completions, events/waits = batch
+    TelemetryCounter epollCtl;          // EPOLL_CTL_MOD bad az coalesce
+    TelemetryCounter bytesIn;
+    TelemetryCounter bytesOut;
+    TelemetryCounter recvEagain;
+    TelemetryCounter sendEagain;
+    TelemetryCounter zeroCopySends;     // sendmsg ba MSG_ZEROCOPY
+    TelemetryCounter zeroCopyCopied;    // completion ke kernel copy karde
+    TelemetryCounter sharedBytes;       // sendFrom: byte haye ke ba reference be slab queue shodan
+    TelemetryCounter fastOpenBytes;     // early data ke ba SYN e connect e barande raft (TCP Fast Open)
+    TelemetryCounter pauses;
+    TelemetryCounter resumes;
+    TelemetryCounter bufferPoolInUse;   // gauge, har dor
+    TelemetryCounter gcQueueLength;     // gauge, har dor
+    TelemetryCounter recvBufferBytes;   // gauge, rBuffer bishtar az RECV_BUFFER_MIN
+    LatencyHistogram loopLatency;       // zaman e process e yek dor (bedoone wait), ns
+    LatencyHistogram connectLatency;    // connectTo ta connected (DNS + Happy Eyeballs), ns
+
+    void print(int shardID) const;
+};
+
+#endif // CLSTELEMETRY_H
@@ -1,3 +1,4 @@
+
 #include "clsTimerManager.h"
 #include "clsSocketList.h"
 #include "clsEpollReactor.h"
@@ -6,11 +7,29 @@
 //#include <unistd.h>
 //#include <iostream>  // For perror, or use printf if preferred
 
+static constexpr uint64_t TICK_NS = (uint64_t)TIMER_WHEEL_TICK_MS * 1000000ull;
+
+static uint64_t monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
 TimerManager::TimerManager() {
     m_SocketContext.fd = -1;
+    m_baseNs = monotonicNs();
 }
 
 TimerManager::~TimerManager() {
+    //node ha male owner hastan, faghat link ha ro baz mikonim
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (uint64_t slot = 0; slot < SLOTS; ++slot) {
+            while (TimerNode *node = m_wheel[level][slot].front())
+                m_wheel[level][slot].remove(node);
+        }
+    }
+
     if (m_SocketContext.fd != -1) {
         if (m_pReactor) {
             m_pReactor->del_fd(m_SocketContext.fd, true);
@@ -41,135 +60,157 @@ void TimerManager::setReactor(EpollReactor *r) {
     }
 }
 
-TimerManager::TimerId TimerManager::addTimer(int interval_ms, Callback cb, bool singleShot) {
-    if (!m_pReactor || m_SocketContext.fd == -1) {
-        return -1;  // Invalid
-    }
+void TimerManager::start(TimerNode *node, int interval_ms, TimerNode::Callback cb, void *arg, bool singleShot) {
+    if (node->isActive())
+        unlink(node);
 
-    TimerId id = m_nextId++;
-    auto now = std::chrono::steady_clock::now();
-    auto expiration = now + std::chrono::milliseconds(interval_ms);
+    uint64_t ticks = (uint64_t)std::max(1, (interval_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS);
+    node->callback = cb;
+    node->arg = arg;
+    node->interval = singleShot ? 0 : (uint32_t)ticks;
+    node->expires = nowTick() + ticks;
+    insert(node);
 
-    m_timers[id] = {std::move(cb), std::chrono::milliseconds(interval_ms), expiration, singleShot};
-    m_expirations.insert({expiration, id});
+    //dar onTick akharesh yek bar arm mishe
+    if (!m_inTick && node->expires < m_armedTick)
+        armAt(node->expires);
+}
 
-    updateTimerFd();
-    return id;
+void TimerManager::stop(TimerNode *node) {
+    //timerfd arm mimoone, bidar shodan e bi mored mohem nist
+    if (node->isActive())
+        unlink(node);
 }
 
-void TimerManager::removeTimer(TimerId id) {
-    auto it = m_timers.find(id);
-    if (it == m_timers.end()) return;
+size_t TimerManager::count() const {
+    return m_count;
+}
 
-    // Remove from expirations
-    auto range = m_expirations.equal_range({it->second.nextExpiration, id});
-    for (auto eit = range.first; eit != range.second; ++eit) {
-        if (eit->second == id) {
-            m_expirations.erase(eit);
-            break;
-        }
+uint64_t TimerManager::nowTick() const {
+    return (monotonicNs() - m_baseNs) / TICK_NS;
+}
+
+void TimerManager::insert(TimerNode *node) {
+    //cascade: expires == m_currentTick hamin tick fire mishe
+    uint64_t expires = std::max(node->expires, m_currentTick);
+    uint64_t delta = expires - m_currentTick;
+    if (delta >= MAX_SPAN) {
+        //dorr tar az wheel: sath e akhar, vaghti be level 0 resid dobare insert mishe
+        delta = MAX_SPAN - 1;
+        expires = m_currentTick + delta;
     }
 
-    m_timers.erase(it);
-    updateTimerFd();
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << (TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+
+    uint64_t slot = (expires >> (TIMER_WHEEL_BITS * level)) & MASK;
+    node->level = (uint8_t)level;
+    node->slot = (uint8_t)slot;
+    m_wheel[level][slot].push_back(node);
+    m_occupied[level] |= 1ull << slot;
+    m_count++;
+}
+
+void TimerManager::unlink(TimerNode *node) {
+    Slot &slot = m_wheel[node->level][node->slot];
+    slot.remove(node);
+    if (slot.empty())
+        m_occupied[node->level] &= ~(1ull << node->slot);
+    m_count--;
 }
 
-void TimerManager::setInterval(TimerId id, int interval_ms) {
-    auto it = m_timers.find(id);
-    if (it == m_timers.end()) return;
+void TimerManager::cascade(int level) {
+    uint64_t slot = (m_currentTick >> (TIMER_WHEEL_BITS * level)) & MASK;
+    if (!(m_occupied[level] & (1ull << slot)))
+        return;
 
-    // Remove old expiration
-    auto range = m_expirations.equal_range({it->second.nextExpiration, id});
-    for (auto eit = range.first; eit != range.second; ++eit) {
-        if (eit->second == id) {
-            m_expirations.erase(eit);
-            break;
-        }
+    while (TimerNode *node = m_wheel[level][slot].front()) {
+        unlink(node);
+        insert(node);
     }
+}
 
-    // Update and add new expiration
-    auto now = std::chrono::steady_clock::now();
-    it->second.interval = std::chrono::milliseconds(interval_ms);
-    it->second.nextExpiration = now + it->second.interval;
-    m_expirations.insert({it->second.nextExpiration, id});
+// tick e badi ke slot e gheyre khali fire ya cascade mishe, UINT64_MAX agar timer nabashe
+uint64_t TimerManager::nextEventTick() const {
+    uint64_t best = UINT64_MAX;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        uint64_t bits = m_occupied[level];
+        if (!bits)
+            continue;
+
+        int shift = TIMER_WHEEL_BITS * level;
+        uint64_t block = m_currentTick >> shift;
+        unsigned first = (unsigned)((block + 1) & MASK);
+        uint64_t rotated = first ? (bits >> first) | (bits << (SLOTS - first)) : bits;
+        uint64_t tick = (block + 1 + (uint64_t)__builtin_ctzll(rotated)) << shift;
+        if (tick < best)
+            best = tick;
+    }
 
-    updateTimerFd();
+    return best;
 }
 
-void TimerManager::onTick() {
-    uint64_t expirations;
-    read(m_SocketContext.fd, &expirations, sizeof(expirations));  // Clear the fd
+void TimerManager::advance(uint64_t targetTick) {
+    while (m_currentTick < targetTick) {
+        //tick haye khali ro skip mikonim
+        uint64_t next = nextEventTick();
+        if (next > targetTick) {
+            m_currentTick = targetTick;
+            return;
+        }
 
-    auto now = std::chrono::steady_clock::now();
-    while (!m_expirations.empty()) {
-        auto first = *m_expirations.begin();
-        if (first.first > now)
-            break;
+        m_currentTick = next;
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+            if (m_currentTick & ((1ull << (TIMER_WHEEL_BITS * level)) - 1))
+                break;
+            cascade(level);
+        }
 
-        m_expirations.erase(m_expirations.begin());
+        Slot &slot = m_wheel[0][m_currentTick & MASK];
+        while (TimerNode *node = slot.front()) {
+            unlink(node);
 
-        auto it = m_timers.find(first.second);
-        if (it != m_timers.end()) {
-            if (it->second.callback) {
-                it->second.callback();
+            //clamp shode (az MAX_SPAN dorr tar bood)
+            if (node->expires > m_currentTick) {
+                insert(node);
+                continue;
             }
 
-            if (it->second.singleShot) {
-                m_timers.erase(it);
-            } else {
-                // Reschedule periodic
-                it->second.nextExpiration = now + it->second.interval;  // Or first.first + interval to avoid drift?
-
-                // To avoid drift, better: it->second.nextExpiration += it->second.interval;
-
-                // But since we might be late, using now + interval restarts from now.
-                // Current code restarts from set time, but to mimic, perhaps use now + interval.
-                m_expirations.insert({it->second.nextExpiration, first.second});
+            //periodic ghabl az callback ta callback betoone stop kone
+            if (node->interval) {
+                node->expires = m_currentTick + node->interval;
+                insert(node);
             }
+
+            node->callback(node->arg);
         }
     }
+}
 
-    updateTimerFd();
-    /*
-    int interval_ms = 200;
-    itimerspec new_value{};
-    new_value.it_value.tv_sec = interval_ms / 1000;
-    new_value.it_value.tv_nsec = (interval_ms % 1000) * 1000000;
-    new_value.it_interval = new_value.it_value; // periodic
-
-    if (timerfd_settime(m_SocketContext.fd, 0, &new_value, nullptr) == -1) {
-        perror("timerfd_settime");
-        close(m_SocketContext.fd);
-        m_SocketContext.fd = -1;
+void TimerManager::onTick() {
+    uint64_t expirations;
+    read(m_SocketContext.fd, &expirations, sizeof(expirations));  // Clear the fd
 
-    }
-*/
+    m_inTick = true;
+    advance(nowTick());
+    m_inTick = false;
 
-    // printf("m_expirations.size %zu\n", m_expirations.size());
+    m_armedTick = UINT64_MAX;
+    armAt(nextEventTick());
 }
 
-void TimerManager::updateTimerFd() {
-
+void TimerManager::armAt(uint64_t tick) {
     itimerspec new_value{};
-    if (m_expirations.empty()) {
-        // Disarm
-        new_value.it_value.tv_sec = 0;
-        new_value.it_value.tv_nsec = 0;
-    } else {
-        auto first = m_expirations.begin()->first;
-        auto now = std::chrono::steady_clock::now();
-        auto duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(first - now).count();
-
-        if (duration_ns <= 0) {
-            // Already expired, set to minimal
-            new_value.it_value.tv_sec = 0;
-            new_value.it_value.tv_nsec = 1;
-        } else {
-            new_value.it_value.tv_sec = duration_ns / 1000000000;
-            new_value.it_value.tv_nsec = duration_ns % 1000000000;
-        }
+    if (tick != UINT64_MAX) {
+        //absolute, ba hamoon CLOCK_MONOTONIC e nowTick()
+        uint64_t ns = m_baseNs + tick * TICK_NS;
+        new_value.it_value.tv_sec = (time_t)(ns / 1000000000ull);
+        new_value.it_value.tv_nsec = (long)(ns % 1000000000ull);
     }
-    if (timerfd_settime(m_SocketContext.fd, 0, &new_value, nullptr) == -1) {
+
+    m_armedTick = tick;
+    if (timerfd_settime(m_SocketContext.fd, TFD_TIMER_ABSTIME, &new_value, nullptr) == -1) {
         perror("timerfd_settime");
     }
 }
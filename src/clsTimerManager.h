@@ -1,45 +1,64 @@
 #ifndef CLSTIMERMANAGER_H
 #define CLSTIMERMANAGER_H
-#include <functional>
-#include <map>
-#include <set>
-#include <chrono>
 #include "SocketContext.h"
+#include "clsIntrusiveList.h"
+
+// timer e intrusive: dakhele owner (reactor, socket, ...) zendegi mikone, TimerManager allocate nemikone
+struct TimerNode {
+    using Callback = void(*)(void *p);
+
+    Callback callback {nullptr};
+    void *arg {nullptr};
+    uint64_t expires {0};       // tick
+    uint32_t interval {0};      // tick, 0 = singleShot
+    uint8_t level {0};
+    uint8_t slot {0};
+    IntrusiveLink link;
+
+    bool isActive() const { return link.next != nullptr; }
+};
 
 class EpollReactor;
+// hierarchical timing wheel (TIMER_WHEEL_LEVELS sath, har sath 64 slot):
+// start/stop O(1), timerfd faghat vaghti timer e zoodtar az arm e feli biad set mishe
 class TimerManager {
 public:
-    using Callback = std::function<void()>;
-    using TimerId = int;
-
     TimerManager();
     ~TimerManager();
 
-    TimerId addTimer(int interval_ms, Callback cb, bool singleShot = false);
-    void removeTimer(TimerId id);
-    void setInterval(TimerId id, int interval_ms);
+    // agar node active bashe, az aval schedule mishe
+    void start(TimerNode *node, int interval_ms, TimerNode::Callback cb, void *arg, bool singleShot = false);
+    void stop(TimerNode *node);
+    size_t count() const;
     void setReactor(EpollReactor *r);
     void onTick();
 
     EpollReactor *getReactor() const;
 
 private:
+    static constexpr uint64_t SLOTS = 1ull << TIMER_WHEEL_BITS;
+    static constexpr uint64_t MASK = SLOTS - 1;
+    static constexpr uint64_t MAX_SPAN = 1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
 
-    void updateTimerFd();
-    int fd() const;
+    using Slot = IntrusiveList<TimerNode, &TimerNode::link>;
 
-    struct TimerInfo {
-        Callback callback;
-        std::chrono::milliseconds interval;
-        std::chrono::steady_clock::time_point nextExpiration;
-        bool singleShot;
-    };
+    int fd() const;
+    uint64_t nowTick() const;
+    void insert(TimerNode *node);
+    void unlink(TimerNode *node);
+    void advance(uint64_t targetTick);
+    void cascade(int level);
+    uint64_t nextEventTick() const;
+    void armAt(uint64_t tick);
 
     EpollReactor* m_pReactor = nullptr;
     struct SocketContext m_SocketContext {};
-    std::map<TimerId, TimerInfo> m_timers;
-    std::multiset<std::pair<std::chrono::steady_clock::time_point, TimerId>> m_expirations;
-    TimerId m_nextId = 0;
+    Slot m_wheel[TIMER_WHEEL_LEVELS][SLOTS];
+    uint64_t m_occupied[TIMER_WHEEL_LEVELS] {};     // bit e slot haye gheyre khali
+    uint64_t m_currentTick {0};                     // akharin tick e process shode
+    uint64_t m_armedTick {UINT64_MAX};
+    uint64_t m_baseNs {0};
+    size_t m_count {0};
+    bool m_inTick {false};
 };
 #endif // CLSTIMERMANAGER_H
-
@@ -0,0 +1,573 @@
+#include "clsUringEngine.h"
+#include "clsEpollReactor.h"
+#include "clsTCPSocket.h"
+#include "constants.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+UringEngine::UringEngine(EpollReactor *pReactor): m_pReactor(pReactor)
+{
+
+}
+
+UringEngine::~UringEngine()
+{
+    for (auto &held : m_heldSends)
+        delete held.second;
+
+    if (m_ringFd != -1)
+        ::close(m_ringFd);
+
+    if (m_bufRing)
+        munmap(m_bufRing, m_bufRingSize);
+
+    if (m_recvBuffers)
+        m_pReactor->bufferPool()->deallocate(m_recvBuffers);
+
+    if (m_sqes)
+        munmap(m_sqes, m_sqesSize);
+
+    if (m_cqRing && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+
+    if (m_sqRing)
+        munmap(m_sqRing, m_sqRingSize);
+}
+
+bool UringEngine::init(unsigned entries)
+{
+    io_uring_params params {};
+
+    // ring ro disable misazim ta thread shard avalin submitter bashe (SINGLE_ISSUER)
+    params.flags = IORING_SETUP_R_DISABLED | IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = entries * 4;
+    m_ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+
+    if (m_ringFd < 0 && errno == EINVAL) {
+        // kernel < 6.1
+        params = {};
+        params.flags = IORING_SETUP_R_DISABLED | IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        m_ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    }
+
+    if (m_ringFd < 0) {
+        perror("io_uring_setup");
+        return false;
+    }
+
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+        printf("io_uring: kernel is too old (EXT_ARG/NODROP not supported)\n");
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_sqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        m_cqRingSize = m_sqRingSize;
+    }
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) {
+        m_sqRing = nullptr;
+        perror("mmap(IORING_OFF_SQ_RING)");
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            m_cqRing = nullptr;
+            perror("mmap(IORING_OFF_CQ_RING)");
+            return false;
+        }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED) {
+        m_sqes = nullptr;
+        perror("mmap(IORING_OFF_SQES)");
+        return false;
+    }
+
+    char *sq = (char*)m_sqRing;
+    m_sqHead = (unsigned*)(sq + params.sq_off.head);
+    m_sqTail = (unsigned*)(sq + params.sq_off.tail);
+    m_sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    m_sqEntries = *(unsigned*)(sq + params.sq_off.ring_entries);
+    m_sqArray = (unsigned*)(sq + params.sq_off.array);
+    m_sqLocalTail = *m_sqTail;
+
+    char *cq = (char*)m_cqRing;
+    m_cqHead = (unsigned*)(cq + params.cq_off.head);
+    m_cqTail = (unsigned*)(cq + params.cq_off.tail);
+    m_cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return setupBufferRing(URING_RECV_BUFFERS, SLAB_SIZE);
+}
+
+bool UringEngine::setupBufferRing(unsigned count, size_t size)
+{
+    m_bufRingSize = count * sizeof(io_uring_buf);
+    void *ring = mmap(nullptr, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) {
+        perror("mmap(buffer ring)");
+        return false;
+    }
+    m_bufRing = (io_uring_buf_ring*)ring;
+
+    // recv buffers az hamoon TLSF pool shard
+    m_recvBuffers = (char*)m_pReactor->bufferPool()->allocate(count * size);
+    if (!m_recvBuffers) {
+        printf("io_uring: can not allocate recv buffers\n");
+        return false;
+    }
+
+    io_uring_buf_reg reg {};
+    reg.ring_addr = (uint64_t)(uintptr_t)m_bufRing;
+    reg.ring_entries = count;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("IORING_REGISTER_PBUF_RING");
+        return false;
+    }
+
+    m_bufCount = count;
+    for (unsigned i = 0; i < count; i++) {
+        io_uring_buf *pBuf = bufferAt(m_bufTail + i);
+        pBuf->addr = (uint64_t)(uintptr_t)(m_recvBuffers + i * size);
+        pBuf->len = (uint32_t)size;
+        pBuf->bid = (uint16_t)i;
+    }
+    m_bufTail += count;
+    __atomic_store_n(&m_bufRing->tail, m_bufTail, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+io_uring_buf *UringEngine::bufferAt(uint16_t index)
+{
+    // #mohem: bufs[] ro mostaghim estefade nakonid, too C++ __DECLARE_FLEX_ARRAY
+    // offset 8 mide (struct khali size 1 dare), vali kernel ring ro az offset 0 mikhoone
+    return reinterpret_cast<io_uring_buf*>(m_bufRing) + (index & (m_bufCount - 1));
+}
+
+void UringEngine::recycleBuffer(uint16_t bid)
+{
+    io_uring_buf *pBuf = bufferAt(m_bufTail);
+    pBuf->addr = (uint64_t)(uintptr_t)(m_recvBuffers + (size_t)bid * SLAB_SIZE);
+    pBuf->len = (uint32_t)SLAB_SIZE;
+    pBuf->bid = bid;
+    m_bufTail++;
+    __atomic_store_n(&m_bufRing->tail, m_bufTail, __ATOMIC_RELEASE);
+}
+
+uint64_t UringEngine::makeUserData(UringOp op, int fd, uint32_t genID)
+{
+    // | genID:32 | op:8 | fd:24 |
+    return (static_cast<uint64_t>(genID) << 32) | (static_cast<uint64_t>(op) << 24) | (static_cast<uint32_t>(fd) & 0xFFFFFF);
+}
+
+uint64_t UringEngine::makePollUserData(int fd, uint32_t genID, uint32_t events)
+{
+    uint8_t flags = 0;
+    if (events & EPOLLIN)
+        flags |= POLL_IN;
+    if (events & EPOLLOUT)
+        flags |= POLL_OUT;
+    if (events & EPOLLRDHUP)
+        flags |= POLL_RDHUP;
+    if (events & EPOLLPRI)
+        flags |= POLL_PRI;
+    return makeUserData(static_cast<UringOp>(OP_POLL | flags), fd, genID);
+}
+
+UringEngine::UringOp UringEngine::extractOp(uint64_t userData)
+{
+    return static_cast<UringOp>((userData >> 24) & OP_MASK);
+}
+
+uint32_t UringEngine::extractPollEvents(uint64_t userData)
+{
+    uint8_t flags = (userData >> 24) & 0xFF;
+    uint32_t events = 0;
+    if (flags & POLL_IN)
+        events |= EPOLLIN;
+    if (flags & POLL_OUT)
+        events |= EPOLLOUT;
+    if (flags & POLL_RDHUP)
+        events |= EPOLLRDHUP;
+    if (flags & POLL_PRI)
+        events |= EPOLLPRI;
+    return events;
+}
+
+int UringEngine::extractFd(uint64_t userData)
+{
+    return static_cast<int>(userData & 0xFFFFFF);
+}
+
+uint32_t UringEngine::extractGen(uint64_t userData)
+{
+    return static_cast<uint32_t>(userData >> 32);
+}
+
+io_uring_sqe *UringEngine::getSqe()
+{
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (m_sqLocalTail - head >= m_sqEntries) {
+        // SQ por shode, ghabl az ezafe kardan submit mikonim
+        if (!m_enabled || submit(0, 0) < 0)
+            return nullptr;
+
+        head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (m_sqLocalTail - head >= m_sqEntries)
+            return nullptr;
+    }
+
+    unsigned idx = m_sqLocalTail & m_sqMask;
+    io_uring_sqe *sqe = &m_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[idx] = idx;
+    m_sqLocalTail++;
+    return sqe;
+}
+
+int UringEngine::submit(unsigned waitCount, int timeout_ms)
+{
+    __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+
+    unsigned flags = 0;
+    io_uring_getevents_arg arg {};
+    __kernel_timespec ts {};
+    if (waitCount > 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    }
+
+    if (toSubmit == 0 && waitCount == 0)
+        return 0;
+
+    return (int)syscall(__NR_io_uring_enter, m_ringFd, toSubmit, waitCount, flags, waitCount > 0 ? &arg : nullptr, waitCount > 0 ? sizeof(arg) : 0);
+}
+
+void UringEngine::run(std::atomic<bool> &stop)
+{
+    if (!m_enabled) {
+        // az inja be bad faghat thread shard submit mikone
+        if (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) < 0) {
+            perror("IORING_REGISTER_ENABLE_RINGS");
+            return;
+        }
+        m_enabled = true;
+    }
+
+    int timeout = URING_WAIT_TIMEOUT_MS;
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        // busy poll: timeout 0 yani faghat submit, montazer e completion nemimoonim
+        int ret = timeout > 0 ? submit(1, timeout) : submit(0, 0);
+        if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            perror("io_uring_enter");
+            break;
+        }
+
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        bool hadEvents = head != tail;
+        m_pReactor->beginIteration((int)(tail - head));
+        while (head != tail) {
+            io_uring_cqe cqe = m_cqes[head & m_cqMask];
+            head++;
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+            onCompletion(&cqe);
+        }
+
+        m_pReactor->endOfIteration();
+        timeout = m_pReactor->nextWaitTimeout(hadEvents, URING_WAIT_TIMEOUT_MS);
+    }
+}
+
+void UringEngine::watch(int fd, uint32_t genID, SockTypes sockType, void *ptr, uint32_t events)
+{
+    if (sockType == IS_TCP_LISTENER) {
+        armAccept(fd, genID);
+        return;
+    }
+
+    if (sockType == IS_TCP_SOCKET) {
+        TCPSocket *pSocket = static_cast<TCPSocket*>(ptr);
+        if (!pSocket)
+            return;
+
+        modify(pSocket->getSocketContext());
+        return;
+    }
+
+    // timer, timer manager, DNS: readiness ba poll multishot
+    armPoll(fd, genID, events);
+}
+
+void UringEngine::modify(SocketContext *pContext)
+{
+    // faghat arm mikonim, op haye dar jaryan khodeshoon tamoom mishan (pause = re-arm nakardan)
+    if ((pContext->ev.events & EPOLLIN) && !(pContext->uringOps & ARMED_RECV))
+        armRecv(pContext);
+
+    if ((pContext->ev.events & EPOLLOUT) && !(pContext->uringOps & ARMED_SEND))
+        armSend(pContext);
+}
+
+void UringEngine::unwatch(int fd)
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        printf("io_uring: SQ full, can not cancel fd=%d\n", fd);
+        return;
+    }
+
+    // hame op haye in fd cancel beshan, ta file ref azad beshe
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = makeUserData(OP_CANCEL, fd, 0);
+
+    //fd ba submit resolve mishe: bad az ::close() EBADF (op ha file ro negah midaran, FIN nemire)
+    //ya socket e jadid ba hamoon fd ro cancel mikone
+    if (m_enabled && submit(0, 0) < 0)
+        perror("io_uring_enter(cancel)");
+}
+
+bool UringEngine::holdSend(SocketContext *pContext)
+{
+    if (!(pContext->uringOps & ARMED_SENDMSG) || !pContext->writeQueue)
+        return false;
+
+    uint32_t genID = static_cast<uint32_t>(pContext->ev.data.u64 >> 32);
+    m_heldSends.push_back({makeUserData(OP_SEND, pContext->fd, genID), pContext->writeQueue});
+    pContext->writeQueue = new SendQueue(*m_pReactor->bufferPool());
+    pContext->uringOps &= ~(ARMED_SEND | ARMED_SENDMSG);
+    return true;
+}
+
+bool UringEngine::releaseHeldSend(uint64_t userData)
+{
+    for (size_t i = 0; i < m_heldSends.size(); i++) {
+        if (m_heldSends[i].first != userData)
+            continue;
+
+        delete m_heldSends[i].second;
+        m_heldSends[i] = m_heldSends.back();
+        m_heldSends.pop_back();
+        return true;
+    }
+    return false;
+}
+
+void UringEngine::armPoll(int fd, uint32_t genID, uint32_t events)
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        printf("io_uring: SQ full, can not poll fd=%d\n", fd);
+        return;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = events & ~EPOLLET;
+    sqe->user_data = makePollUserData(fd, genID, events);
+}
+
+void UringEngine::armAccept(int fd, uint32_t genID)
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        printf("io_uring: SQ full, can not accept fd=%d\n", fd);
+        return;
+    }
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = makeUserData(OP_ACCEPT, fd, genID);
+}
+
+void UringEngine::armRecv(SocketContext *pContext)
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        printf("io_uring: SQ full, can not recv fd=%d\n", pContext->fd);
+        return;
+    }
+
+    // buffer ro kernel az buffer ring entekhab mikone, pas ta completion buffer ee ghofl nemishe
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = pContext->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = makeUserData(OP_RECV, pContext->fd, static_cast<uint32_t>(pContext->ev.data.u64 >> 32));
+    pContext->uringOps |= ARMED_RECV;
+}
+
+void UringEngine::armSend(SocketContext *pContext)
+{
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        printf("io_uring: SQ full, can not send fd=%d\n", pContext->fd);
+        return;
+    }
+
+    uint32_t genID = static_cast<uint32_t>(pContext->ev.data.u64 >> 32);
+    SendQueue *pQueue = pContext->writeQueue;
+    if (!pQueue || pQueue->empty()) {
+        // chizi baraye ersal nist, faghat writable ro montazer mimoonim (onWritable)
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = pContext->fd;
+        sqe->poll32_events = EPOLLOUT;
+        sqe->user_data = makeUserData(OP_WRITABLE, pContext->fd, genID);
+        pContext->uringOps |= ARMED_SEND;
+        return;
+    }
+
+    // iovec ha too SocketContext mimoonan ta completion
+    size_t batchBytes = 0;
+    size_t iovCount = pQueue->fillIov(pContext->uringIov, URING_MAX_SEND_IOV, MAX_SEND_BATCH_BYTES, batchBytes);
+
+    memset(&pContext->uringMsg, 0, sizeof(pContext->uringMsg));
+    pContext->uringMsg.msg_iov = pContext->uringIov;
+    pContext->uringMsg.msg_iovlen = iovCount;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = pContext->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&pContext->uringMsg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeUserData(OP_SEND, pContext->fd, genID);
+    pContext->uringOps |= ARMED_SEND | ARMED_SENDMSG;
+}
+
+void UringEngine::onCompletion(const io_uring_cqe *cqe)
+{
+    UringOp op = extractOp(cqe->user_data);
+    if (op == OP_CANCEL)
+        return;
+
+    //socket baste shode, hala kernel az chunk ha nemikhoone
+    if (op == OP_SEND && !m_heldSends.empty() && releaseHeldSend(cqe->user_data))
+        return;
+
+    int fd = extractFd(cqe->user_data);
+    SockInfo *pInfo = m_pReactor->m_pConnectionList->get(fd, extractGen(cqe->user_data));
+    if (!pInfo) {
+        // socket ghablan baste shode (genID avaz shode)
+        if (cqe->flags & IORING_CQE_F_BUFFER)
+            recycleBuffer((uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+        return;
+    }
+
+    switch (op) {
+    case OP_POLL: {
+        if (cqe->res == -ECANCELED)
+            return;
+
+        uint32_t ev = cqe->res < 0 ? (uint32_t)EPOLLERR : (uint32_t)cqe->res;
+        m_pReactor->dispatchEvent(pInfo, fd, ev);
+
+        if (!(cqe->flags & IORING_CQE_F_MORE) && m_pReactor->m_pConnectionList->get(fd, extractGen(cqe->user_data)))
+            armPoll(fd, extractGen(cqe->user_data), extractPollEvents(cqe->user_data));
+        break;
+    }
+    case OP_ACCEPT: {
+        if (cqe->res >= 0) {
+            m_pReactor->acceptFd(cqe->res);
+        } else if (cqe->res != -ECANCELED && cqe->res != -EAGAIN) {
+            printf("accept: %s\n", strerror(-cqe->res));
+        }
+
+        if (!(cqe->flags & IORING_CQE_F_MORE) && cqe->res != -ECANCELED && m_pReactor->m_pConnectionList->get(fd, extractGen(cqe->user_data)))
+            armAccept(fd, extractGen(cqe->user_data));
+        break;
+    }
+    case OP_RECV:
+        onRecvCompletion(pInfo, cqe);
+        break;
+    case OP_SEND:
+        onSendCompletion(pInfo, cqe->res);
+        break;
+    case OP_WRITABLE: {
+        TCPSocket *pSocket = static_cast<TCPSocket*>(pInfo->socketBasePtr);
+        if (!pSocket)
+            return;
+
+        pSocket->getSocketContext()->uringOps &= ~ARMED_SEND;
+        if (cqe->res > 0)
+            pSocket->onWritable();
+        rearmTCP(pSocket);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void UringEngine::onRecvCompletion(SockInfo *pInfo, const io_uring_cqe *cqe)
+{
+    TCPSocket *pSocket = static_cast<TCPSocket*>(pInfo->socketBasePtr);
+    if (!pSocket) {
+        if (cqe->flags & IORING_CQE_F_BUFFER)
+            recycleBuffer((uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+        return;
+    }
+
+    pSocket->getSocketContext()->uringOps &= ~ARMED_RECV;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        pSocket->onRecvCompleted(reinterpret_cast<const uint8_t*>(m_recvBuffers + (size_t)bid * SLAB_SIZE), cqe->res);
+        recycleBuffer(bid);
+    } else {
+        pSocket->onRecvCompleted(nullptr, cqe->res);
+    }
+
+    rearmTCP(pSocket);
+}
+
+void UringEngine::onSendCompletion(SockInfo *pInfo, int res)
+{
+    TCPSocket *pSocket = static_cast<TCPSocket*>(pInfo->socketBasePtr);
+    if (!pSocket)
+        return;
+
+    pSocket->getSocketContext()->uringOps &= ~(ARMED_SEND | ARMED_SENDMSG);
+    pSocket->onSendCompleted(res);
+    rearmTCP(pSocket);
+}
+
+void UringEngine::rearmTCP(TCPSocket *pSocket)
+{
+    SocketContext *pContext = pSocket->getSocketContext();
+    if (pSocket->getStatus() == TCPSocket::Closed || pContext->fd == -1)
+        return;
+
+    // callback momkene socket ro baste bashe
+    if (!m_pReactor->m_pConnectionList->get(pContext->fd, static_cast<uint32_t>(pContext->ev.data.u64 >> 32)))
+        return;
+
+    modify(pContext);
+}
@@ -0,0 +1,126 @@
+#ifndef CLSURINGENGINE_H
+#define CLSURINGENGINE_H
+// ============================== UringEngine ==================================
+// io_uring backend for EpollReactor: accept, recv and sendmsg are submitted
+// as ring operations, completions go through the same SocketList / SockInfo
+// lookup as the epoll loop. Outbound connect (Happy Eyeballs) is a non-blocking
+// connect() plus a poll on the attempt fd. Raw syscalls, no liburing dependency.
+#include "clsSocketList.h"
+#include "SocketContext.h"
+#include <linux/io_uring.h>
+// linux/fs.h BLOCK_SIZE ro macro mikone, ba moodycamel::ConcurrentQueue tadakhol dare
+#undef BLOCK_SIZE
+#include <sys/socket.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class EpollReactor;
+class TCPSocket;
+class UringEngine
+{
+public:
+    explicit UringEngine(EpollReactor *pReactor);
+    ~UringEngine();
+
+    bool init(unsigned entries);
+    void run(std::atomic<bool> &stop);
+
+    // called by EpollReactor::register_fd/addFlags/removeFlags/del_fd
+    void watch(int fd, uint32_t genID, SockTypes sockType, void *ptr, uint32_t events);
+    void modify(SocketContext *pContext);
+    // cancel hamoon ja submit mishe (ghabl az ::close() e caller)
+    void unwatch(int fd);
+    // close(true) ba sendmsg e dar jaryan: writeQueue ta CQE e OP_SEND negah dashte mishe
+    // (kernel hanooz az chunk ha mikhoone), context queue e khali migire. false = sendmsg nadare
+    bool holdSend(SocketContext *pContext);
+
+private:
+    enum UringOp : uint8_t {
+        OP_POLL = 1,
+        OP_ACCEPT = 2,
+        OP_RECV = 3,
+        OP_SEND = 4,
+        OP_WRITABLE = 5,
+        OP_CANCEL = 7
+    };
+
+    // OP_POLL: mask e register (timer/DNS EPOLLIN, connect attempt EPOLLOUT) too bit haye bala ye op,
+    // baraye re-arm vaghti multishot tamoom mishe
+    enum : uint8_t {
+        OP_MASK = 0x0F,
+        POLL_IN = 1 << 4,
+        POLL_OUT = 1 << 5,
+        POLL_RDHUP = 1 << 6,
+        POLL_PRI = 1 << 7
+    };
+
+    // SocketContext::uringOps bits
+    enum : uint8_t {
+        ARMED_RECV = 1 << 0,
+        ARMED_SEND = 1 << 1,
+        ARMED_SENDMSG = 1 << 3      // ARMED_SEND ba data (na poll e writable)
+    };
+
+    EpollReactor *m_pReactor {nullptr};
+    int m_ringFd {-1};
+    bool m_enabled {false};
+
+    // submission ring
+    void *m_sqRing {nullptr};
+    size_t m_sqRingSize {0};
+    unsigned *m_sqHead {nullptr};
+    unsigned *m_sqTail {nullptr};
+    unsigned *m_sqArray {nullptr};
+    unsigned m_sqMask {0};
+    unsigned m_sqEntries {0};
+    unsigned m_sqLocalTail {0};
+    unsigned m_sqSubmitted {0};
+    io_uring_sqe *m_sqes {nullptr};
+    size_t m_sqesSize {0};
+
+    // completion ring
+    void *m_cqRing {nullptr};
+    size_t m_cqRingSize {0};
+    unsigned *m_cqHead {nullptr};
+    unsigned *m_cqTail {nullptr};
+    unsigned m_cqMask {0};
+    io_uring_cqe *m_cqes {nullptr};
+
+    // provided recv buffers (kernel picks one per completion)
+    io_uring_buf_ring *m_bufRing {nullptr};
+    size_t m_bufRingSize {0};
+    char *m_recvBuffers {nullptr};
+    unsigned m_bufCount {0};
+    uint16_t m_bufTail {0};
+
+    // user_data e OP_SEND -> queue e socket e baste shode, ta completion
+    std::vector<std::pair<uint64_t, SendQueue*>> m_heldSends;
+
+    static uint64_t makeUserData(UringOp op, int fd, uint32_t genID);
+    static uint64_t makePollUserData(int fd, uint32_t genID, uint32_t events);
+    static UringOp extractOp(uint64_t userData);
+    static uint32_t extractPollEvents(uint64_t userData);
+    static int extractFd(uint64_t userData);
+    static uint32_t extractGen(uint64_t userData);
+
+    io_uring_sqe *getSqe();
+    int submit(unsigned waitCount, int timeout_ms);
+    bool setupBufferRing(unsigned count, size_t size);
+    io_uring_buf *bufferAt(uint16_t index);
+    void recycleBuffer(uint16_t bid);
+
+    void armPoll(int fd, uint32_t genID, uint32_t events);
+    void armAccept(int fd, uint32_t genID);
+    void armRecv(SocketContext *pContext);
+    void armSend(SocketContext *pContext);
+    void cancel(uint64_t userData);
+    bool releaseHeldSend(uint64_t userData);
+
+    void onCompletion(const io_uring_cqe *cqe);
+    void onRecvCompletion(SockInfo *pInfo, const io_uring_cqe *cqe);
+    void onSendCompletion(SockInfo *pInfo, int res);
+    void rearmTCP(TCPSocket *pSocket);
+};
+
+#endif // CLSURINGENGINE_H
@@ -5,7 +5,17 @@
 // Epoll and Socket Constants
 static constexpr int MAX_EVENTS = 1024;             // batch epoll_wait
 static constexpr int LISTEN_BACKLOG = 4096;
-//static constexpr int IDLE_TIMEOUT_SEC = 30;       // graceful idle GC
+static constexpr int FASTOPEN_QUEUE_LEN = 256;      // TCP_FASTOPEN e listener, SYN haye data dar ke hanooz accept nashodan
+static constexpr size_t POSTED_TASKS_BATCH = 64;    // try_dequeue_bulk
+static constexpr size_t POSTED_TASKS_PER_LOOP = 1024;   // baghie dor e baad
+static constexpr int EPOLL_WAIT_TIMEOUT_MS = 1000;
+static constexpr int BUSY_POLL_BUDGET_US = 50;          // default e --busy-poll
+// deadline haye har connection (timing wheel)
+static constexpr int IDLE_TIMEOUT_SECS = 0;             // default e reactor, 0 = khamoosh
+static constexpr int CONNECT_TIMEOUT_MS = 10*1000;      // az connect() ta connected
+static constexpr int HE_RESOLUTION_DELAY_MS = 50;       // Happy Eyeballs: A zoodtar omad, montazer e AAAA (RFC 8305)
+static constexpr int HE_ATTEMPT_DELAY_MS = 250;         // Happy Eyeballs: fasele connect e address haye badi
+static constexpr int SOCKS_HANDSHAKE_TIMEOUT_MS = 15*1000; // greeting ta connected, bishtar az CONNECT_TIMEOUT_MS
 
 
 // DNS Lookup Configuration Constants
@@ -18,17 +28,49 @@ constexpr unsigned int DNS_MAX_RETRIES = 3;
 static constexpr size_t BUFFER_POOL_SIZE = 200 * (1024*1024);    //200M for 25K coonection
 static constexpr size_t BACK_PRESSURE = 128*1024;                //1*(1024*1024); //1 MG
 static constexpr size_t SLAB_SIZE = 8 * 1024;                    // 8KB socket buffer
+static constexpr size_t RECV_BUFFER_MIN = 4 * 1024;             // rBuffer e avalie, flow e idle be in barmigarde
+static constexpr size_t RECV_BUFFER_MAX = 256 * 1024;            // bulk flow ya frame e naghes ta inja bozorg mishe
+static constexpr size_t RECV_BUFFER_BUDGET = 64 * (1024*1024);   // har shard, majmoo e rBuffer ha bishtar az RECV_BUFFER_MIN
+static constexpr int RECV_BUFFER_GROW_STREAK = 2;                // recv e por poshte sar ham ta 2x
+constexpr int RECV_BUFFER_IDLE_MS = 2000;                        // bedoone recv/send ta in zaman -> RECV_BUFFER_MIN
 //static constexpr size_t HIGH_WATERMARK = 64 * 1024;
 static constexpr size_t LOW_WATERMARK = 64 * 1024;
+static constexpr size_t MAX_SEND_BATCH_BYTES = 256 * 1024;       // max bytes per sendmsg
+static constexpr size_t SEND_CHUNK_SIZE = 16 * 1024;             // chunk e SendQueue (ba header), write haye koochik append mishan
+static constexpr size_t SHARED_SEND_MIN_BYTES = 4 * 1024;        // sendFrom: koochik tar copy mishe, slab e bozorg baraye chand byte negah dashte nemishe
+static constexpr size_t SEND_MAX_IOV = 64;                       // iovec haye stack e onWritable, MAX_SEND_BATCH_BYTES / chunk kafie
+static constexpr size_t ZEROCOPY_MIN_BYTES = 32 * 1024;          // batch e koochik tar copy arzoon tare (MSG_ZEROCOPY)
+static constexpr int ZEROCOPY_COPIED_LIMIT = 8;                  // completion e COPIED poshte sar ham (loopback) -> khamoosh
+static constexpr size_t READ_BUDGET_BYTES = 64 * 1024;           // har socket dar har dor, baghie be ready list
+static constexpr int READ_BUDGET_CALLS = 16;                     // recv() per socket per dor
+static constexpr size_t SPLICE_PIPE_SIZE = 128 * 1024;           // pipe e har samt e relay (F_SETPIPE_SZ), mesle BACK_PRESSURE
+
+
+// io_uring backend
+static constexpr unsigned URING_QUEUE_DEPTH = 4096;             // SQ entries, CQ = 4x
+static constexpr unsigned URING_RECV_BUFFERS = 1024;            // provided recv buffers (power of 2), SLAB_SIZE each
+static constexpr unsigned URING_BUFFER_GROUP = 1;
+static constexpr size_t URING_MAX_SEND_IOV = 16;                // iovecs per in-flight sendmsg
+constexpr int URING_WAIT_TIMEOUT_MS = 1000;                     // mesle timeout epoll_wait
+
+
+// hot upgrade (Server::handoffTo / adoptHandoff)
+static constexpr const char *HANDOFF_SOCKET_PATH = "/tmp/epoll_new.handoff";
+constexpr int DRAIN_TIMEOUT_SECS = 5*60;                // bad az handoff, connection haye ghadimi ta in zaman
+constexpr int HANDOFF_SHARD_TIMEOUT_MS = 5*1000;        // handoffTo: montazer e ersal e connection haye har shard
 
 
 // Timer Intervals (in milliseconds)
 constexpr int UPDATE_CACHED_NOW      = 1000;
 constexpr int DNS_TIMEOUT_INTERVAL_MS      = 200;
 constexpr int GARBAGE_COLLECTOR_INTERVAL_MS = 10*1000;  // 10 seconds
-constexpr int IDLE_CONNECTION_INTERVAL_MS = 30*1000;    // 30 seconds
-constexpr int CLOSE_WAIT_INTERVAL_MS = 10*1000;          // 10 seconds
-constexpr int CLOSING_TIMEOUT_SECS = 60;                // 60 seconds
+constexpr int CLOSING_TIMEOUT_SECS = 60;                // 60 seconds, Closing ta drain e SendQueue
+
+// TimerManager: hierarchical timing wheel, TIMER_WHEEL_LEVELS * 64 slot
+// 64^5 tick * 1ms ~ 12 rooz, bishtar clamp va dobare cascade mishe
+constexpr int TIMER_WHEEL_TICK_MS = 1;
+constexpr int TIMER_WHEEL_BITS = 6;
+constexpr int TIMER_WHEEL_LEVELS = 5;
 
 // Keep-Alive socket
 //